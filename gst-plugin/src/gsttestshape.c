@@ -61,9 +61,17 @@
 #endif
 
 #include <math.h>
+#include <stdio.h>
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include "gsttestshape.h"
+#include "gsttestshapebatch.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_testshape_debug);
+#define GST_CAT_DEFAULT gst_testshape_debug
+
+/* Tracer record of the draw of each frame, logged with GST_DEBUG=GST_TRACER:7. */
+static GstTracerRecord *tr_draw;
 
 /* Enum to define a set of properties for plugin. */
 enum
@@ -79,31 +87,85 @@ enum
 	PROP_TRIANGLE_SIZE,
 	PROP_SQUARE_SIZE,
 	PROP_CIRCLE_RADIUS,
+	PROP_THICKNESS,
+	PROP_FILL,
+	PROP_SHAPES,
+	PROP_ROI,
+	PROP_ROI_COLORS,
+	PROP_ALPHA,
+	PROP_N_THREADS,
+	PROP_CLIP,
+	PROP_SCHEDULE,
+	PROP_SKIP_STATIC,
+	PROP_ANTIALIAS,
+	PROP_CHROMA_COVERAGE,
+	PROP_FONT,
+	PROP_FONT_SIZE,
+	PROP_ROI_LABELS,
+	PROP_OVERLAY_META,
+	PROP_STATS_INTERVAL,
+	PROP_FRAMES,
+	PROP_PIXELS,
+	PROP_SPANS,
+	PROP_DRAW_TIME_P50,
+	PROP_DRAW_TIME_P99,
 };
 
+/* Band of rows [y0, y1) of a frame drawn by one thread, y0 is even so that
+ * no chroma row is shared with another band.
+ */
+typedef struct
+{
+    Gsttestshape *filter;
+    const TestshapeImage *image;
+    gint y0;
+    gint y1;
+} TestshapeBand;
+
+/* Below this number of drawn pixels per band the draw stays on the streaming thread. */
+#define TESTSHAPE_BAND_MIN_PIXELS (64 * 1024)
+
+/* Alignment mask of the memory, and of the strides when downstream takes video
+ * metas, of the buffers allocated by the element: 32 bytes, an AVX2 register.
+ */
+#define TESTSHAPE_POOL_ALIGN 31
+
 /* Capabilities of input and output pads */
 static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("video/x-raw, format=(string)NV12, width=(int)[1, 3840], height=(int)[1, 2160], framerate=(fraction)[0/1, 30/1]")
+    GST_STATIC_CAPS ("video/x-raw, format=(string)" TESTSHAPE_WRITER_FORMATS ", width=(int)[1, 3840], height=(int)[1, 2160], framerate=" GST_VIDEO_FPS_RANGE)
     );
 
 static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("video/x-raw, format=(string)NV12, width=(int)[1, 3840], height=(int)[1, 2160], framerate=(fraction)[0/1, 30/1]")
+    GST_STATIC_CAPS ("video/x-raw, format=(string)" TESTSHAPE_WRITER_FORMATS ", width=(int)[1, 3840], height=(int)[1, 2160], framerate=" GST_VIDEO_FPS_RANGE)
     );
 
-/* Defines a new GObject-derived type with name Gsttestshape that inherits from the GST_TYPE_ELEMENT type. */ 
-G_DEFINE_TYPE (Gsttestshape, gst_testshape, GST_TYPE_ELEMENT);
+/* Defines a new GObject-derived type with name Gsttestshape that inherits from the GST_TYPE_VIDEO_FILTER type.
+ * GstVideoFilter is a GstBaseTransform that takes care of caps parsing and frame mapping.
+ */ 
+G_DEFINE_TYPE (Gsttestshape, gst_testshape, GST_TYPE_VIDEO_FILTER);
 
 /* To register an element called as testshape. */
 GST_ELEMENT_REGISTER_DEFINE (testshape, "testshape", GST_RANK_NONE, GST_TYPE_TESTSHAPE);
 
-/* Declaration of _set _get and chain function. */
+/* Declaration of _set _get and transform functions. */
 static void gst_testshape_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_testshape_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
-static GstFlowReturn gst_testshape_chain (GstPad * pad, GstObject * parent, GstBuffer * buf);
+static void gst_testshape_finalize (GObject * object);
+static void gst_testshape_before_transform (GstBaseTransform * trans, GstBuffer * buf);
+static gboolean gst_testshape_sink_event (GstBaseTransform * trans, GstEvent * event);
+static gboolean gst_testshape_src_event (GstBaseTransform * trans, GstEvent * event);
+static gboolean gst_testshape_start (GstBaseTransform * trans);
+static gboolean gst_testshape_stop (GstBaseTransform * trans);
+static gboolean gst_testshape_propose_allocation (GstBaseTransform * trans, GstQuery * decide_query, GstQuery * query);
+static gboolean gst_testshape_transform_meta (GstBaseTransform * trans, GstBuffer * outbuf, GstMeta * meta, GstBuffer * inbuf);
+static GstFlowReturn gst_testshape_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * inbuf, GstBuffer ** outbuf);
+static GstFlowReturn gst_testshape_transform_ip (GstBaseTransform * trans, GstBuffer * buf);
+static gboolean gst_testshape_set_info (GstVideoFilter * vfilter, GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info);
+static GstFlowReturn gst_testshape_transform_frame_ip (GstVideoFilter * vfilter, GstVideoFrame * frame);
 
 /* gst_testshape_class_init function used to initialize class for Gsttestshape element.
  * It is used to configure the behavior of the Gsttestshape class when it's instantiated 
@@ -113,48 +175,156 @@ static void gst_testshape_class_init (GsttestshapeClass * klass)    //sets class
 {
     GObjectClass *gobject_class;
     GstElementClass *gstelement_class;
+    GstBaseTransformClass *trans_class;
+    GstVideoFilterClass *vfilter_class;
     
     gobject_class = (GObjectClass *) klass;
     gstelement_class = (GstElementClass *) klass;
+    trans_class = (GstBaseTransformClass *) klass;
+    vfilter_class = (GstVideoFilterClass *) klass;
     
     gobject_class->set_property = gst_testshape_set_property;
     gobject_class->get_property = gst_testshape_get_property;
+    gobject_class->finalize = gst_testshape_finalize;
     
     /* g_object_class_install_property is called to install properties for testshape element. */
     g_object_class_install_property(gobject_class, PROP_SHAPE,
-    	g_param_spec_string("shape", "Shape", "SHAPE: Rectangle, Triangle, Square, Circle", "rectangle", G_PARAM_READWRITE));
+    	g_param_spec_string("shape", "Shape", "SHAPE: Rectangle, Triangle, Square, Circle (polygons and polylines are drawn from the shapes list)", "rectangle", G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_COLOR,
-        g_param_spec_string("color", "Color", "COLOR: Red, Green, Blue", "blue", G_PARAM_READWRITE));
+        g_param_spec_string("color", "Color", "COLOR: Red, Green, Blue, #RRGGBB or #AARRGGBB", "blue", G_PARAM_READWRITE));
     
     g_object_class_install_property(gobject_class, PROP_X,
-        g_param_spec_int("x", "x", "X-corodinate", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE));
+        g_param_spec_int("x", "x", "X-corodinate", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
 
     g_object_class_install_property(gobject_class, PROP_Y,
-        g_param_spec_int("y", "y", "Y-corodinate", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE));
+        g_param_spec_int("y", "y", "Y-corodinate", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
     
     g_object_class_install_property (gobject_class, PROP_COORDINATE,
         g_param_spec_boolean ("coordinate", "Coordinate", "set when need to pass the coordinate for shape", FALSE, G_PARAM_READWRITE));
 
     g_object_class_install_property(gobject_class, PROP_RECT_L,
-        g_param_spec_int("rect_l", "Rectangle_length", "length of rectangle", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE));
+        g_param_spec_int("rect_l", "Rectangle_length", "length of rectangle", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
 
     g_object_class_install_property(gobject_class, PROP_RECT_H,
-        g_param_spec_int("rect_h", "Rectangle_height", "height of rectangle", INT_MIN, INT_MAX, 100, G_PARAM_READWRITE));
+        g_param_spec_int("rect_h", "Rectangle_height", "height of rectangle", INT_MIN, INT_MAX, 100, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
 
     g_object_class_install_property(gobject_class, PROP_TRIANGLE_SIZE,
-        g_param_spec_int("triangle_size", "Triangle_Size", "Size of Triangle", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE));
+        g_param_spec_int("triangle_size", "Triangle_Size", "Size of Triangle", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
     
     g_object_class_install_property(gobject_class, PROP_SQUARE_SIZE,
-        g_param_spec_int("square_size", "Square_size", "Size of Square ", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE));
+        g_param_spec_int("square_size", "Square_size", "Size of Square ", INT_MIN, INT_MAX, 200, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
     
     g_object_class_install_property(gobject_class, PROP_CIRCLE_RADIUS,
-        g_param_spec_int("circle_radius", "Circle_radius", "Radius of Circle", INT_MIN, INT_MAX, 100, G_PARAM_READWRITE));
+        g_param_spec_int("circle_radius", "Circle_radius", "Radius of Circle", INT_MIN, INT_MAX, 100, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
+
+    g_object_class_install_property(gobject_class, PROP_THICKNESS,
+        g_param_spec_int("thickness", "Thickness", "Stroke thickness of the shape outline in pixels", 1, INT_MAX, 1, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
+
+    g_object_class_install_property(gobject_class, PROP_FILL,
+        g_param_spec_boolean("fill", "Fill", "Draw the shape filled instead of only its outline", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_SHAPES,
+        g_param_spec_string("shapes", "Shapes", "List of shapes drawn in one pass instead of the single shape, "
+            "e.g. \"rectangle, x=100, y=80, width=60, height=40, color=green; circle, x=300, y=200, radius=30\"",
+            NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ROI,
+        g_param_spec_boolean("roi", "ROI", "Draw a rectangle for every GstVideoRegionOfInterestMeta of the incoming buffers "
+            "instead of the single shape", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ROI_COLORS,
+        g_param_spec_string("roi_colors", "ROI_colors", "Colors of the ROI rectangles by ROI type or label, "
+            "e.g. \"person=red, car=blue\"; others use the color property", NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ALPHA,
+        g_param_spec_double("alpha", "Alpha", "Opacity of the shapes, from 0.0 (invisible) to 1.0 (opaque), "
+            "multiplied with the alpha of #AARRGGBB colors", 0.0, 1.0, 1.0, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
+
+    g_object_class_install_property(gobject_class, PROP_N_THREADS,
+        g_param_spec_uint("n_threads", "N_threads", "Maximum number of threads drawing horizontal bands of the frame, "
+            "0 for the number of processors", 0, 128, 1, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_CLIP,
+        g_param_spec_string("clip", "Clip", "Rectangle \"x,y,width,height\" outside of which nothing is drawn, "
+            "empty for the whole frame", NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_SCHEDULE,
+        g_param_spec_string("schedule", "Schedule", "File of \"pts,shapes\" lines in PTS order, the shapes of every buffer "
+            "are those of the last entry at or before its PTS", NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_SKIP_STATIC,
+        g_param_spec_boolean("skip_static", "Skip_static", "Output the last drawn frame again for GAP flagged buffers, "
+            "which repeat the previous frame, as long as the shapes do not change", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ANTIALIAS,
+        g_param_spec_boolean("antialias", "Antialias", "Blend the edges of the shapes by the part of each pixel they cover "
+            "instead of drawing whole pixels", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_CHROMA_COVERAGE,
+        g_param_spec_boolean("chroma_coverage", "Chroma_coverage", "Blend the subsampled chroma on the edges of shapes "
+            "drawn without anti-aliasing by the part of its pixels they cover", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_FONT,
+        g_param_spec_string("font", "Font", "Font file of the labels, a common sans font is looked for if not set",
+            NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_FONT_SIZE,
+        g_param_spec_int("font_size", "Font_size", "Pixel size of the labels",
+            1, TESTSHAPE_ATLAS_MAX_SIZE, 16, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ROI_LABELS,
+        g_param_spec_boolean("roi_labels", "Roi_labels", "Write the label and confidence of every ROI above its rectangle",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_OVERLAY_META,
+        g_param_spec_boolean("overlay_meta", "Overlay_meta", "Attach the shapes as an overlay composition meta instead of "
+            "drawing them when downstream supports it, the frames are then left untouched", FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL,
+        g_param_spec_uint("stats_interval", "Stats_interval", "Post a testshape-stats element message with the counters "
+            "every that many frames, 0 posts none", 0, G_MAXUINT, 0, G_PARAM_READWRITE));
+
+    /* Counters since the element was started, read only. */
+    g_object_class_install_property(gobject_class, PROP_FRAMES,
+        g_param_spec_uint64("frames", "Frames", "Number of frames handled, drawn into or not",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_PIXELS,
+        g_param_spec_uint64("pixels", "Pixels", "Number of pixels written into the frames",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_SPANS,
+        g_param_spec_uint64("spans", "Spans", "Number of spans rasterized, for the shapes and the ROI rectangles",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_DRAW_TIME_P50,
+        g_param_spec_uint64("draw_time_p50", "Draw_time_p50", "Median time taken to draw a frame, in nanoseconds",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_DRAW_TIME_P99,
+        g_param_spec_uint64("draw_time_p99", "Draw_time_p99", "99th percentile of the time taken to draw a frame, in nanoseconds",
+            0, G_MAXUINT64, 0, G_PARAM_READABLE));
 
 	/* Used to set details of Gsttestshape element.
 	 * It is used to provide essential information about the element's properties, 
 	 * signals, and other characteristics.
 	 */
+    GST_DEBUG_CATEGORY_INIT (gst_testshape_debug, "testshape", 0, "testshape overlay drawing");
+
+    tr_draw = gst_tracer_record_new ("testshape-draw.class",
+        "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+            "type", G_TYPE_GTYPE, G_TYPE_STRING,
+            "related-to", GST_TYPE_TRACER_VALUE_SCOPE, GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+        "time", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "time taken to draw the frame in ns", NULL),
+        "pixels", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+            "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+            "description", G_TYPE_STRING, "pixels written into the frame", NULL),
+        NULL);
+    GST_OBJECT_FLAG_SET (tr_draw, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+
     gst_element_class_set_details_simple (gstelement_class,
     	"testshape",
    	   	"FIXME:Generic",
@@ -164,46 +334,207 @@ static void gst_testshape_class_init (GsttestshapeClass * klass)    //sets class
 	/* This is used to add pad templates to source and sink of Gsttestshape element. */
     gst_element_class_add_pad_template (gstelement_class, gst_static_pad_template_get (&src_factory));
     gst_element_class_add_pad_template (gstelement_class, gst_static_pad_template_get (&sink_factory));
+    
+    /* Shapes are drawn in place; passthrough frames are not handed to transform_frame_ip. */
+    trans_class->transform_ip_on_passthrough = FALSE;
+    trans_class->before_transform = GST_DEBUG_FUNCPTR (gst_testshape_before_transform);
+    trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_testshape_sink_event);
+    trans_class->src_event = GST_DEBUG_FUNCPTR (gst_testshape_src_event);
+    trans_class->start = GST_DEBUG_FUNCPTR (gst_testshape_start);
+    trans_class->stop = GST_DEBUG_FUNCPTR (gst_testshape_stop);
+    trans_class->propose_allocation = GST_DEBUG_FUNCPTR (gst_testshape_propose_allocation);
+    trans_class->transform_meta = GST_DEBUG_FUNCPTR (gst_testshape_transform_meta);
+    trans_class->prepare_output_buffer = GST_DEBUG_FUNCPTR (gst_testshape_prepare_output_buffer);
+    trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_testshape_transform_ip);
+    vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_testshape_set_info);
+    vfilter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_testshape_transform_frame_ip);
+}
+
+/* Returns a copy of the property values owning its own strings. */
+static TestshapeConfig * gst_testshape_config_copy (const TestshapeConfig * props)
+{
+    TestshapeConfig *config = g_new (TestshapeConfig, 1);
+    
+    *config = *props;
+    config->shape = g_strdup (props->shape);
+    config->color = g_strdup (props->color);
+    config->shapes = g_strdup (props->shapes);
+    config->roi_colors = g_strdup (props->roi_colors);
+    config->clip = g_strdup (props->clip);
+    config->schedule = g_strdup (props->schedule);
+    config->font = g_strdup (props->font);
+    
+    return config;
+}
+
+/* Sets the default property values. */
+void gst_testshape_config_init (TestshapeConfig * config)
+{
+    config->shape = g_strdup ("square");
+    config->color = g_strdup ("red");
+    config->x = 200;
+    config->y = 200;
+    config->coordinate = FALSE;
+    config->rect_l = 200;
+    config->rect_h = 100;
+    config->triangle_size = 200;
+    config->square_size = 200;
+    config->circle_radius = 100;
+    config->thickness = 1;
+    config->fill = FALSE;
+    config->shapes = NULL;
+    config->roi = FALSE;
+    config->roi_colors = NULL;
+    config->alpha = 1.0;
+    config->n_threads = 1;
+    config->clip = NULL;
+    config->schedule = NULL;
+    config->skip_static = FALSE;
+    config->antialias = FALSE;
+    config->chroma_coverage = FALSE;
+    config->font = NULL;
+    config->font_size = 16;
+    config->roi_labels = FALSE;
+    config->overlay_meta = FALSE;
+    config->stats_interval = 0;
 }
 
-/* gst_testshape_init function initializes the instance-specific data, 
- * sets default property values, and creates and adds input and output pads 
- * to Gsttestshape element
+/* Frees the strings of a set of property values. */
+void gst_testshape_config_clear (TestshapeConfig * config)
+{
+    g_free(config->shape);
+    g_free(config->color);
+    g_free(config->shapes);
+    g_free(config->roi_colors);
+    g_free(config->clip);
+    g_free(config->schedule);
+    g_free(config->font);
+}
+
+static void gst_testshape_config_free (TestshapeConfig * config)
+{
+    gst_testshape_config_clear (config);
+    g_free(config);
+}
+
+/* Publishes a snapshot of the property values for the streaming thread,
+ * called with the object lock held. A snapshot the streaming thread has not
+ * taken yet is replaced and freed, it was never seen by the streaming thread.
  */
-static void gst_testshape_init (Gsttestshape * filter)
+static void gst_testshape_publish_config (Gsttestshape * filter)
 {
-    /* Create new pads from the static pad templates*/
-    filter->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
+    TestshapeConfig *config = gst_testshape_config_copy (&filter->props);
+    TestshapeConfig *old;
     
-    /* gst_pad_set_chain_function function sets the chain function for the sinkpad.*/
-    gst_pad_set_chain_function (filter->sinkpad, GST_DEBUG_FUNCPTR (gst_testshape_chain));
+    do {
+        old = g_atomic_pointer_get (&filter->pending_config);
+    } while (!g_atomic_pointer_compare_and_exchange (&filter->pending_config, old, config));
     
-    /* Used to set proxy caps on a sink pad of an element.
-     * Enables dynamic negotiation of data formats between elements in pipeline.
-     */
-    GST_PAD_SET_PROXY_CAPS (filter->sinkpad);
+    if (old != NULL)
+        gst_testshape_config_free (old);
+}
+
+/* Takes the latest published snapshot, NULL if the properties did not change.
+ * Only called by the streaming thread, it never blocks on the object lock.
+ */
+static TestshapeConfig * gst_testshape_take_config (Gsttestshape * filter)
+{
+    TestshapeConfig *config;
     
-    filter->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
-    GST_PAD_SET_PROXY_CAPS (filter->srcpad);
-	
-	/* It add pads to Gsttestshape element.
-	 * Allows flow of data in and out of element through pads.
-	 */
-    gst_element_add_pad (GST_ELEMENT (filter), filter->sinkpad);
-    gst_element_add_pad (GST_ELEMENT (filter), filter->srcpad);
+    do {
+        config = g_atomic_pointer_get (&filter->pending_config);
+    } while (config != NULL && !g_atomic_pointer_compare_and_exchange (&filter->pending_config, config, NULL));
+    
+    return config;
+}
+
+/* gst_testshape_init function initializes the instance-specific data 
+ * and sets default property values of Gsttestshape element.
+ * The sink and src pads are created by GstBaseTransform from the pad templates.
+ */
+static void gst_testshape_init (Gsttestshape * filter)
+{
+    /* Shapes are drawn directly into the incoming buffer. */
+    gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
     
     /* Properties of an element which can be set by the user to control behavior.*/
-    strcpy(filter->shape, "square");
-    strcpy(filter->color, "red");
-    filter->x = 200;
-    filter->y = 200;
-    filter->coordinate = FALSE;
-    filter->rect_l = 200;
-    filter->rect_h = 100;
-    filter->triangle_size = 200;
-    filter->square_size = 200;
-    filter->circle_radius = 100;
+    gst_testshape_config_init (&filter->props);
+    filter->runner = NULL;
+    
+    /* The streaming thread starts from the defaults. */
+    filter->config = gst_testshape_config_copy (&filter->props);
+    filter->pending_config = NULL;
+    
+    /* The draw plan is compiled lazily once caps are known. */
+    gst_testshape_plan_init (&filter->plan);
+    gst_testshape_plan_init (&filter->roi_plan);
+    filter->plan_valid = FALSE;
+    filter->plan_threads = 1;
+    filter->plan_roi = FALSE;
+    filter->roi_color_table = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    filter->roi_plan_valid = FALSE;
+    filter->schedule = NULL;
+    filter->schedule_file = NULL;
+    filter->schedule_shapes = NULL;
+    filter->drawn_buffer = NULL;
+    filter->replay = FALSE;
+    filter->atlas = NULL;
+    filter->atlas_font = NULL;
+    filter->atlas_opened = FALSE;
+    filter->sprites = gst_testshape_sprites_new ();
+    filter->allocation_checked = FALSE;
+    filter->overlay_supported = FALSE;
+    filter->video_meta_supported = FALSE;
+    filter->pool = NULL;
+    filter->overlay = FALSE;
+    filter->composition = NULL;
+    filter->stats = gst_testshape_stats_new ();
+    filter->stats_frames = 0;
     
+    /* Span fill kernels matching the CPU. */
+    filter->fill_funcs = gst_testshape_fill_get_funcs ();
+}
+
+/* Deactivates and drops the pool frames are copied into, if any. */
+static void gst_testshape_release_pool (Gsttestshape * filter)
+{
+    if (filter->pool == NULL)
+        return;
+    
+    gst_buffer_pool_set_active (filter->pool, FALSE);
+    gst_object_unref (filter->pool);
+    filter->pool = NULL;
+}
+
+/* Releases the resources owned by the Gsttestshape element. */
+static void gst_testshape_finalize (GObject * object)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (object);
+
+    gst_testshape_config_clear (&filter->props);
+    gst_testshape_config_free (filter->config);
+    if (filter->pending_config != NULL)
+        gst_testshape_config_free (filter->pending_config);
+    gst_testshape_plan_clear (&filter->plan);
+    gst_testshape_plan_clear (&filter->roi_plan);
+    g_hash_table_unref (filter->roi_color_table);
+    if (filter->runner != NULL)
+        gst_testshape_task_runner_free (filter->runner);
+    if (filter->schedule != NULL)
+        gst_testshape_schedule_free (filter->schedule);
+    g_free(filter->schedule_file);
+    g_free(filter->schedule_shapes);
+    gst_buffer_replace (&filter->drawn_buffer, NULL);
+    if (filter->atlas != NULL)
+        gst_testshape_atlas_free (filter->atlas);
+    g_free(filter->atlas_font);
+    gst_testshape_sprites_free (filter->sprites);
+    gst_testshape_release_pool (filter);
+    if (filter->composition != NULL)
+        gst_video_overlay_composition_unref (filter->composition);
+    gst_testshape_stats_free (filter->stats);
+
+    G_OBJECT_CLASS (gst_testshape_parent_class)->finalize (object);
 }
 
 /* gst_testshape_set_property funtion sets property of Gsttestshape element. */
@@ -211,42 +542,132 @@ static void gst_testshape_set_property (GObject * object, guint prop_id, const G
 {
     Gsttestshape *filter = GST_TESTSHAPE (object);
     
+    GST_OBJECT_LOCK (filter);
+    
     /* To check prop_id value and determine which property is being set. */
     switch (prop_id) {
         case PROP_SHAPE:
-            strcpy(filter->shape, g_value_get_string(value));
+            g_free(filter->props.shape);
+            filter->props.shape = g_value_dup_string(value);
             break;
         case PROP_COLOR:
-            strcpy(filter->color, g_value_get_string(value));
+            g_free(filter->props.color);
+            filter->props.color = g_value_dup_string(value);
             break;
         case PROP_X:
-            filter->x = g_value_get_int(value);
+            filter->props.x = g_value_get_int(value);
             break;
         case PROP_Y:
-            filter->y = g_value_get_int(value);
+            filter->props.y = g_value_get_int(value);
             break;
         case PROP_COORDINATE:
-            filter->coordinate = g_value_get_boolean (value);
+            filter->props.coordinate = g_value_get_boolean (value);
             break;
         case PROP_RECT_L:
-            filter->rect_l = g_value_get_int(value);
+            filter->props.rect_l = g_value_get_int(value);
             break;
         case PROP_RECT_H:
-            filter->rect_h = g_value_get_int(value);
+            filter->props.rect_h = g_value_get_int(value);
             break;
         case PROP_TRIANGLE_SIZE:
-            filter->triangle_size = g_value_get_int(value);
+            filter->props.triangle_size = g_value_get_int(value);
             break;
         case PROP_SQUARE_SIZE:
-            filter->square_size = g_value_get_int(value);
+            filter->props.square_size = g_value_get_int(value);
             break;
         case PROP_CIRCLE_RADIUS:
-            filter->circle_radius = g_value_get_int(value);
+            filter->props.circle_radius = g_value_get_int(value);
+            break;
+        case PROP_THICKNESS:
+            filter->props.thickness = g_value_get_int(value);
+            break;
+        case PROP_FILL:
+            filter->props.fill = g_value_get_boolean(value);
+            break;
+        case PROP_SHAPES:
+            g_free(filter->props.shapes);
+            filter->props.shapes = g_value_dup_string(value);
+            break;
+        case PROP_ROI:
+            filter->props.roi = g_value_get_boolean(value);
+            break;
+        case PROP_ROI_COLORS:
+            g_free(filter->props.roi_colors);
+            filter->props.roi_colors = g_value_dup_string(value);
+            break;
+        case PROP_ALPHA:
+            filter->props.alpha = g_value_get_double(value);
+            break;
+        case PROP_N_THREADS:
+            filter->props.n_threads = g_value_get_uint(value);
+            break;
+        case PROP_CLIP:
+            g_free(filter->props.clip);
+            filter->props.clip = g_value_dup_string(value);
+            break;
+        case PROP_SCHEDULE:
+            g_free(filter->props.schedule);
+            filter->props.schedule = g_value_dup_string(value);
+            break;
+        case PROP_SKIP_STATIC:
+            filter->props.skip_static = g_value_get_boolean(value);
+            break;
+        case PROP_ANTIALIAS:
+            filter->props.antialias = g_value_get_boolean(value);
+            break;
+        case PROP_CHROMA_COVERAGE:
+            filter->props.chroma_coverage = g_value_get_boolean(value);
+            break;
+        case PROP_FONT:
+            g_free(filter->props.font);
+            filter->props.font = g_value_dup_string(value);
+            break;
+        case PROP_FONT_SIZE:
+            filter->props.font_size = g_value_get_int(value);
+            break;
+        case PROP_ROI_LABELS:
+            filter->props.roi_labels = g_value_get_boolean(value);
+            break;
+        case PROP_OVERLAY_META:
+            filter->props.overlay_meta = g_value_get_boolean(value);
+            break;
+        case PROP_STATS_INTERVAL:
+            filter->props.stats_interval = g_value_get_uint(value);
             break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
             break;
     }
+    
+    /* Any property change hands a new snapshot to the streaming thread. */
+    gst_testshape_publish_config (filter);
+    GST_OBJECT_UNLOCK (filter);
+}
+
+/* Reads one of the counters, they are updated without the object lock. */
+static void gst_testshape_get_stats_property (Gsttestshape * filter, guint prop_id, GValue * value)
+{
+    TestshapeStatsValues values;
+    
+    gst_testshape_stats_get (filter->stats, &values);
+    
+    switch (prop_id) {
+        case PROP_FRAMES:
+            g_value_set_uint64(value, values.frames);
+            break;
+        case PROP_PIXELS:
+            g_value_set_uint64(value, values.pixels);
+            break;
+        case PROP_SPANS:
+            g_value_set_uint64(value, values.spans);
+            break;
+        case PROP_DRAW_TIME_P50:
+            g_value_set_uint64(value, values.draw_time_p50);
+            break;
+        default:
+            g_value_set_uint64(value, values.draw_time_p99);
+            break;
+    }
 }
 
 /* Called after setting Gsttestshape element property to get properrty. */
@@ -257,34 +678,106 @@ static void gst_testshape_get_property (GObject * object, guint prop_id, GValue
     /* To check prop_id value and determine which property is being retrieved.*/
     switch (prop_id) {
         case PROP_SHAPE:
-            g_value_set_string(value, filter->shape);
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.shape);
+            GST_OBJECT_UNLOCK (filter);
             break;
         case PROP_COLOR:
-            g_value_set_string(value, filter->color);
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.color);
+            GST_OBJECT_UNLOCK (filter);
             break;
         case PROP_X:
-            g_value_set_int(value, filter->x);
+            g_value_set_int(value, filter->props.x);
             break;
         case PROP_Y:
-            g_value_set_int(value, filter->y);
+            g_value_set_int(value, filter->props.y);
             break;
         case PROP_COORDINATE:
-            g_value_set_boolean (value, filter->coordinate);
+            g_value_set_boolean (value, filter->props.coordinate);
             break;
         case PROP_RECT_L:
-            g_value_set_int(value, filter->rect_l);
+            g_value_set_int(value, filter->props.rect_l);
             break;
         case PROP_RECT_H:
-            g_value_set_int(value, filter->rect_h);
+            g_value_set_int(value, filter->props.rect_h);
             break;
         case PROP_TRIANGLE_SIZE:
-            g_value_set_int(value, filter->triangle_size);
+            g_value_set_int(value, filter->props.triangle_size);
             break;
         case PROP_SQUARE_SIZE:
-            g_value_set_int(value, filter->square_size);
+            g_value_set_int(value, filter->props.square_size);
             break;
         case PROP_CIRCLE_RADIUS:
-            g_value_set_int(value, filter->circle_radius);
+            g_value_set_int(value, filter->props.circle_radius);
+            break;
+        case PROP_THICKNESS:
+            g_value_set_int(value, filter->props.thickness);
+            break;
+        case PROP_FILL:
+            g_value_set_boolean(value, filter->props.fill);
+            break;
+        case PROP_SHAPES:
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.shapes);
+            GST_OBJECT_UNLOCK (filter);
+            break;
+        case PROP_ROI:
+            g_value_set_boolean(value, filter->props.roi);
+            break;
+        case PROP_ROI_COLORS:
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.roi_colors);
+            GST_OBJECT_UNLOCK (filter);
+            break;
+        case PROP_ALPHA:
+            g_value_set_double(value, filter->props.alpha);
+            break;
+        case PROP_N_THREADS:
+            g_value_set_uint(value, filter->props.n_threads);
+            break;
+        case PROP_CLIP:
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.clip);
+            GST_OBJECT_UNLOCK (filter);
+            break;
+        case PROP_SCHEDULE:
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.schedule);
+            GST_OBJECT_UNLOCK (filter);
+            break;
+        case PROP_SKIP_STATIC:
+            g_value_set_boolean(value, filter->props.skip_static);
+            break;
+        case PROP_ANTIALIAS:
+            g_value_set_boolean(value, filter->props.antialias);
+            break;
+        case PROP_CHROMA_COVERAGE:
+            g_value_set_boolean(value, filter->props.chroma_coverage);
+            break;
+        case PROP_FONT:
+            GST_OBJECT_LOCK (filter);
+            g_value_set_string(value, filter->props.font);
+            GST_OBJECT_UNLOCK (filter);
+            break;
+        case PROP_FONT_SIZE:
+            g_value_set_int(value, filter->props.font_size);
+            break;
+        case PROP_ROI_LABELS:
+            g_value_set_boolean(value, filter->props.roi_labels);
+            break;
+        case PROP_OVERLAY_META:
+            g_value_set_boolean(value, filter->props.overlay_meta);
+            break;
+        case PROP_STATS_INTERVAL:
+            g_value_set_uint(value, filter->props.stats_interval);
+            break;
+        case PROP_FRAMES:
+        case PROP_PIXELS:
+        case PROP_SPANS:
+        case PROP_DRAW_TIME_P50:
+        case PROP_DRAW_TIME_P99:
+            gst_testshape_get_stats_property (filter, prop_id, value);
             break;
 		default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -292,335 +785,1191 @@ static void gst_testshape_get_property (GObject * object, guint prop_id, GValue
     }
 }
 
-/* Function to draw SQUARE shape. */
-static void drawSquare(GstVideoFrame *frame, gint x1, gint y1, gint size, guint8 *y_data, guint8 *u_data, guint8 *v_data, gchar *color, gint square_x1, gint square_y1, gint square_x2, gint square_y2) {
-
-	/* examines the position of each pixel in the frame and 
-	 * checks whether it falls within the boundaries of the square.
-	 */
-    if (((x1 == square_x1 || x1 == square_x2 - 1) && (y1 >= square_y1 && y1 < square_y2)) ||
-        ((y1 == square_y1 || y1 == square_y2 - 1) && (x1 >= square_x1 && x1 < square_x2))) {
-        /* pixel values are set to red. */
-        if (strcmp(color, "red") == 0) {
-            *y_data = 76;
-            *u_data = 84;
-            *v_data = 255;
-        } 
-        /* pixel values are set to green. */
-        else if (strcmp(color, "green") == 0) {
-            *y_data = 149;
-            *u_data = 43;
-            *v_data = 21;
-        } 
-        /* pixel values are set to blue. */
-        else if (strcmp(color, "blue") == 0) {
-            *y_data = 29;
-            *u_data = 255;
-            *v_data = 107;
+/* Builds the shape described by the single shape properties. */
+static gboolean gst_testshape_property_shape (Gsttestshape * filter, TestshapeShape * shape, gint width, gint height)
+{
+    const TestshapeConfig *config = filter->config;
+    
+    memset(shape, 0, sizeof(*shape));
+    shape->type = gst_testshape_shape_type_from_string (config->shape);
+    shape->thickness = config->thickness;
+    shape->fill = config->fill;
+    shape->antialias = config->antialias;
+    
+    if (shape->type == TESTSHAPE_SHAPE_NONE || !gst_testshape_color_parse (config->color, &shape->color))
+        return FALSE;
+    gst_testshape_color_set_alpha (&shape->color, config->alpha);
+    
+    /* If the user does not provide coordinates 'x' and 'y',
+     * then by default it is set to FALSE and the shape is centered in the frame.
+     */
+    if (config->coordinate == FALSE) {
+        shape->x = width / 2;
+        shape->y = height / 2;
+        
+        switch (shape->type) {
+            case TESTSHAPE_SHAPE_RECTANGLE:
+                shape->width = width / 2;
+                shape->height = height / 2;
+                break;
+            case TESTSHAPE_SHAPE_TRIANGLE:
+                shape->width = 50;
+                break;
+            default:
+                /* Square size and circle radius. */
+                shape->width = MIN(width, height) / 4;
+                break;
+        }
+    }
+    
+    /* If user sets the coordinate to TRUE and provides 'x' and 'y' coordinates,
+     * then the shape is centered on them.
+     */
+    else {
+        shape->x = config->x;
+        shape->y = config->y;
+        
+        switch (shape->type) {
+            case TESTSHAPE_SHAPE_RECTANGLE:
+                shape->width = config->rect_l;
+                shape->height = config->rect_h;
+                break;
+            case TESTSHAPE_SHAPE_TRIANGLE:
+                shape->width = config->triangle_size;
+                break;
+            case TESTSHAPE_SHAPE_SQUARE:
+                shape->width = config->square_size;
+                break;
+            default:
+                shape->width = config->circle_radius;
+                break;
         }
     }
+    
+    return TRUE;
 }
 
-/* Function to draw CIRCLE shape. */
-static void drawCircle(GstVideoFrame *frame, gint x1, gint y1, gint radius, guint8 *y_data, guint8 *u_data, guint8 *v_data, gchar *color, gint circle_x, gint circle_y){
-    gint distance_from_center_squared = (x1 - circle_x) * (x1 - circle_x) + (y1 - circle_y) * (y1 - circle_y);
+/* Appends the vertices of a polygon or polyline, an array of alternating x and y
+ * values such as points=<10, 10, 200, 40, 150, 300>, to the points of the plan.
+ */
+static gboolean gst_testshape_parse_points (GstObject * object, const GstStructure * structure, TestshapePlan * plan, TestshapeShape * shape)
+{
+    const GValue *points = gst_structure_get_value (structure, "points");
+    guint i, size;
     
-    /* examines the position of each pixel in the frame and 
-	 * checks whether it falls within the boundaries of the circle.
-	 */
-    if (distance_from_center_squared <= radius * radius &&
-        distance_from_center_squared >= (radius - 1) * (radius - 1)) {
-        /* pixel values are set to red. */
-        if (strcmp(color, "red") == 0) {
-            *y_data = 76;
-            *u_data = 84;
-            *v_data = 255;
-        } 
-        /* pixel values are set to green. */
-        else if (strcmp(color, "green") == 0) {
-            *y_data = 149;
-            *u_data = 43;
-            *v_data = 21;
-        } 
-        /* pixel values are set to blue. */
-        else if (strcmp(color, "blue") == 0) {
-            *y_data = 29;
-            *u_data = 255;
-            *v_data = 107;
+    if (points == NULL || !GST_VALUE_HOLDS_ARRAY (points))
+        return FALSE;
+    
+    size = gst_value_array_get_size (points);
+    shape->first_point = plan->points->len;
+    shape->n_points = size / 2;
+    g_array_set_size(plan->points, plan->points->len + shape->n_points);
+    
+    for (i = 0; i < shape->n_points * 2; i++) {
+        const GValue *value = gst_value_array_get_value (points, i);
+        TestshapePoint *point = &g_array_index(plan->points, TestshapePoint, shape->first_point + i / 2);
+        
+        if (!G_VALUE_HOLDS_INT (value)) {
+            GST_WARNING_OBJECT (object, "points must be integers");
+            g_array_set_size(plan->points, shape->first_point);
+            return FALSE;
         }
+        
+        if (i % 2 == 0)
+            point->x = g_value_get_int (value);
+        else
+            point->y = g_value_get_int (value);
     }
+    
+    return TRUE;
 }
 
-/* Function to draw RECTANGLE shape. */
-static void drawRectangle(GstVideoFrame *frame, gint x1, gint y1, gint width, gint height, guint8 *y_data, guint8 *u_data, guint8 *v_data, gchar *color, gint rect_x1, gint rect_y1, gint rect_x2, gint rect_y2){
+/* Appends the UTF-8 text of a label to the text of the plan. */
+static gboolean gst_testshape_add_text (GstObject * object, TestshapePlan * plan, TestshapeShape * shape, const gchar * text)
+{
+    if (!g_utf8_validate (text, -1, NULL)) {
+        GST_WARNING_OBJECT (object, "label is not valid UTF-8");
+        return FALSE;
+    }
     
-    /* examines the position of each pixel in the frame and 
-	 * checks whether it falls within the boundaries of the rectangle.
-	 */
-    if (((x1 == rect_x1 || x1 == rect_x2 - 1) && (y1 >= rect_y1 && y1 < rect_y2)) ||
-        ((y1 == rect_y1 || y1 == rect_y2 - 1) && (x1 >= rect_x1 && x1 < rect_x2))) {
-        /* pixel values are set to red. */
-        if (strcmp(color, "red") == 0) {
-            *y_data = 76;
-            *u_data = 84;
-            *v_data = 255;
-        } 
-        /* pixel values are set to green. */
-        else if (strcmp(color, "green") == 0) {
-            *y_data = 149;
-            *u_data = 43;
-            *v_data = 21;
-        } 
-        /* pixel values are set to blue. */
-        else if (strcmp(color, "blue") == 0) {
-            *y_data = 29;
-            *u_data = 255;
-            *v_data = 107;
+    shape->text_offset = plan->text->len;
+    shape->text_length = strlen (text);
+    g_array_append_vals(plan->text, text, shape->text_length);
+    
+    return TRUE;
+}
+
+/* Parses a shape list, from the shapes property or the schedule, into the shapes of a plan.
+ * Every entry is a GstStructure named after the shape, entries are separated by ';':
+ * "rectangle, x=100, y=80, width=60, height=40, color=green; circle, x=300, y=200, radius=30"
+ * Polygons and polylines take their vertices from points, offset by x and y:
+ * "polygon, points=<10, 10, 200, 40, 150, 300>, fill=true, rule=evenodd"
+ * Any shape may carry a label written above it, text entries draw a string
+ * with the top left corner of its line at x and y:
+ * "circle, x=300, y=200, radius=30, label=ball; text, x=10, y=10, text=\"frame 1\", size=24"
+ * Sprites stamp an image file with its top left corner at x and y, at its
+ * own size unless width or height are given. Masks take the color:
+ * "sprite, x=200, y=100, file=logo.pam; sprite, x=50, y=50, file=mask.pgm, width=32, color=yellow"
+ * Fields that are not given fall back to the single shape properties.
+ */
+void gst_testshape_parse_shapes (GstObject * object, const TestshapeConfig * config, const gchar * str, TestshapePlan * plan)
+{
+    gchar *end;
+    
+    while (str != NULL && *str != '\0') {
+        GstStructure *structure;
+        TestshapeShape shape;
+        const gchar *color, *rule, *text;
+        gdouble alpha;
+        
+        while (*str == ';' || g_ascii_isspace (*str))
+            str++;
+        if (*str == '\0')
+            break;
+        
+        structure = gst_structure_from_string (str, &end);
+        if (structure == NULL) {
+            GST_WARNING_OBJECT (object, "invalid shape description: %s", str);
+            break;
         }
+        str = end;
+        
+        memset(&shape, 0, sizeof(shape));
+        shape.type = gst_testshape_shape_type_from_string (gst_structure_get_name (structure));
+        shape.x = config->x;
+        shape.y = config->y;
+        shape.thickness = config->thickness;
+        shape.fill = config->fill;
+        shape.antialias = config->antialias;
+        gst_structure_get_int (structure, "x", &shape.x);
+        gst_structure_get_int (structure, "y", &shape.y);
+        gst_structure_get_int (structure, "thickness", &shape.thickness);
+        gst_structure_get_boolean (structure, "fill", &shape.fill);
+        gst_structure_get_boolean (structure, "antialias", &shape.antialias);
+        
+        switch (shape.type) {
+            case TESTSHAPE_SHAPE_RECTANGLE:
+                shape.width = config->rect_l;
+                shape.height = config->rect_h;
+                gst_structure_get_int (structure, "width", &shape.width);
+                gst_structure_get_int (structure, "height", &shape.height);
+                break;
+            case TESTSHAPE_SHAPE_TRIANGLE:
+                shape.width = config->triangle_size;
+                gst_structure_get_int (structure, "size", &shape.width);
+                break;
+            case TESTSHAPE_SHAPE_SQUARE:
+                shape.width = config->square_size;
+                gst_structure_get_int (structure, "size", &shape.width);
+                break;
+            case TESTSHAPE_SHAPE_CIRCLE:
+                shape.width = config->circle_radius;
+                gst_structure_get_int (structure, "radius", &shape.width);
+                break;
+            case TESTSHAPE_SHAPE_POLYGON:
+            case TESTSHAPE_SHAPE_POLYLINE:
+                /* Vertices are in frame coordinates unless moved by x and y. */
+                shape.x = 0;
+                shape.y = 0;
+                gst_structure_get_int (structure, "x", &shape.x);
+                gst_structure_get_int (structure, "y", &shape.y);
+                rule = gst_structure_get_string (structure, "rule");
+                shape.rule = g_strcmp0 (rule, "evenodd") == 0 ? TESTSHAPE_FILL_EVENODD : TESTSHAPE_FILL_NONZERO;
+                if (!gst_testshape_parse_points (object, structure, plan, &shape))
+                    shape.type = TESTSHAPE_SHAPE_NONE;
+                break;
+            case TESTSHAPE_SHAPE_SPRITE:
+                /* Sizes of 0 are resolved from the image once it is loaded. */
+                gst_structure_get_int (structure, "width", &shape.width);
+                gst_structure_get_int (structure, "height", &shape.height);
+                text = gst_structure_get_string (structure, "file");
+                if (text == NULL || shape.width < 0 || shape.height < 0) {
+                    shape.type = TESTSHAPE_SHAPE_NONE;
+                    break;
+                }
+                shape.sprite_offset = plan->files->len;
+                shape.sprite_length = strlen (text);
+                g_array_append_vals(plan->files, text, shape.sprite_length + 1);
+                break;
+            case TESTSHAPE_SHAPE_TEXT:
+                /* A height of 0 draws the text at the font_size property. */
+                gst_structure_get_int (structure, "size", &shape.height);
+                shape.height = MAX(shape.height, 0);
+                text = gst_structure_get_string (structure, "text");
+                if (text == NULL || !gst_testshape_add_text (object, plan, &shape, text))
+                    shape.type = TESTSHAPE_SHAPE_NONE;
+                break;
+            default:
+                break;
+        }
+        shape.thickness = MAX(shape.thickness, 1);
+        
+        text = gst_structure_get_string (structure, "label");
+        if (shape.type != TESTSHAPE_SHAPE_TEXT && shape.type != TESTSHAPE_SHAPE_SPRITE &&
+            shape.type != TESTSHAPE_SHAPE_NONE && text != NULL)
+            gst_testshape_add_text (object, plan, &shape, text);
+        
+        color = gst_structure_get_string (structure, "color");
+        if (shape.type == TESTSHAPE_SHAPE_NONE || !gst_testshape_color_parse (color ? color : config->color, &shape.color)) {
+            GST_WARNING_OBJECT (object, "ignoring shape %s", gst_structure_get_name (structure));
+        } else {
+            alpha = config->alpha;
+            gst_structure_get_double (structure, "alpha", &alpha);
+            gst_testshape_color_set_alpha (&shape.color, alpha);
+            g_array_append_val(plan->shapes, shape);
+        }
+        
+        gst_structure_free (structure);
     }
 }
 
-/* Function to draw TRIANGLE shape. */
-static void drawTriangle(GstVideoFrame *frame, gint x1, gint y1, gint size, guint8 *y_data, guint8 *u_data, guint8 *v_data, gchar *color, gint triangle_x1, gint triangle_y1, gint triangle_x2, gint triangle_y2, gint triangle_x3){
+/* Reads the image files of the sprites of a plan and fills in their sizes. */
+void gst_testshape_load_sprites (GstObject * object, TestshapeSprites * sprites, TestshapePlan * plan)
+{
+    guint i;
     
-    /* examines the position of each pixel in the frame and 
-	 * checks whether it falls within the boundaries of the traingle.
-	 */
-    if ((y1 >= triangle_y1 && y1 <= triangle_y2) &&
-        ((x1 <= triangle_x1 && x1 >= triangle_x2) || (x1 >= triangle_x1 && x1 <= triangle_x3))) {
-        if ((x1 + y1 == triangle_y1 + triangle_x1) || (x1 - y1 == triangle_x1 - triangle_y1)) {
-            /* pixel values are set to red. */
-            if (strcmp(color, "red") == 0) {
-                *y_data = 76;
-                *u_data = 84;
-                *v_data = 255;
-            } 
-            /* pixel values are set to green. */
-            else if (strcmp(color, "green") == 0) {
-                *y_data = 149;
-                *u_data = 43;
-                *v_data = 21;
-            } 
-            /* pixel values are set to blue. */
-            else if (strcmp(color, "blue") == 0) {
-                *y_data = 29;
-                *u_data = 255;
-                *v_data = 107;
-            }
+    for (i = 0; i < plan->shapes->len; i++) {
+        TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, i);
+        const gchar *file = (const gchar *) plan->files->data + shape->sprite_offset;
+        GError *error = NULL;
+        gint width, height;
+        
+        if (shape->type != TESTSHAPE_SHAPE_SPRITE)
+            continue;
+        
+        if (!gst_testshape_sprites_load (sprites, file, &width, &height, &error)) {
+            GST_WARNING_OBJECT (object, "ignoring sprite: %s", error->message);
+            g_error_free (error);
+            shape->type = TESTSHAPE_SHAPE_NONE;
+            continue;
         }
+        
+        /* A single size keeps the aspect ratio of the image. */
+        if (shape->width == 0 && shape->height == 0) {
+            shape->width = width;
+            shape->height = height;
+        } else if (shape->width == 0) {
+            shape->width = (gint) MAX((gint64) shape->height * width / height, 1);
+        } else if (shape->height == 0) {
+            shape->height = (gint) MAX((gint64) shape->width * height / width, 1);
+        }
+        shape->width = MIN(shape->width, TESTSHAPE_SPRITE_MAX_SIZE);
+        shape->height = MIN(shape->height, TESTSHAPE_SPRITE_MAX_SIZE);
     }
-	
-	/* examines the position of each pixel in the frame and 
-	 * checks whether it falls within the boundaries of the triangle.
-	 */
-    if (y1 == triangle_y2) {
-        if (x1 >= triangle_x2 && x1 <= triangle_x3) {
-            /* pixel values are set to red. */
-            if (strcmp(color, "red") == 0) {
-                *y_data = 76;
-                *u_data = 84;
-                *v_data = 255;
-            } 
-            /* pixel values are set to green. */
-            else if (strcmp(color, "green") == 0) {
-                *y_data = 149;
-                *u_data = 43;
-                *v_data = 21;
-            } 
-            /* pixel values are set to blue. */
-            else if (strcmp(color, "blue") == 0) {
-                *y_data = 29;
-                *u_data = 255;
-                *v_data = 107;
-            }
+}
+
+/* Parses the roi_colors property, a comma separated list of type=color pairs,
+ * into a table from the ROI type quark to the color.
+ */
+static void gst_testshape_parse_roi_colors (Gsttestshape * filter, GHashTable * colors)
+{
+    const TestshapeConfig *config = filter->config;
+    gchar **entries;
+    guint i;
+    
+    if (config->roi_colors == NULL)
+        return;
+    
+    entries = g_strsplit (config->roi_colors, ",", -1);
+    for (i = 0; entries[i] != NULL; i++) {
+        gchar **pair = g_strsplit (entries[i], "=", 2);
+        TestshapeColor color;
+        
+        if (pair[0] != NULL && pair[1] != NULL && gst_testshape_color_parse (g_strstrip (pair[1]), &color)) {
+            TestshapeColor *value = g_new (TestshapeColor, 1);
+            
+            gst_testshape_color_set_alpha (&color, config->alpha);
+            *value = color;
+            g_hash_table_insert (colors, GUINT_TO_POINTER (g_quark_from_string (g_strstrip (pair[0]))), value);
+        } else {
+            GST_WARNING_OBJECT (filter, "invalid ROI color: %s", entries[i]);
         }
+        g_strfreev (pair);
     }
+    g_strfreev (entries);
 }
 
-/* gst_testshape_chain function is used to process actual data in sink pad.
- * In this, it processes the video frames and is responsible to apply visual effects to video frames.
+/* Parses the clip property, "x,y,width,height", into a rectangle.
+ * Returns FALSE when it is unset or invalid, shapes are then clipped to the frame only.
  */
-static GstFlowReturn gst_testshape_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+static gboolean gst_testshape_parse_clip (Gsttestshape * filter, TestshapeRect * clip)
 {
-    Gsttestshape *filter;
-    GstCaps *caps;
-    GstVideoInfo in_info;
-    GstVideoFrame frame;
-    gint x1, y1;
+    const TestshapeConfig *config = filter->config;
+    
+    if (config->clip == NULL || *config->clip == '\0')
+        return FALSE;
+
+    if (sscanf (config->clip, "%d , %d , %d , %d", &clip->x, &clip->y, &clip->width, &clip->height) != 4 ||
+        clip->width < 0 || clip->height < 0) {
+        GST_WARNING_OBJECT (filter, "invalid clip rectangle: %s", config->clip);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Opens the font of the labels, once until the font property changes. The
+ * glyphs rasterized so far stay cached as long as the same font is used.
+ */
+static void gst_testshape_update_atlas (Gsttestshape * filter)
+{
+    const gchar *font = filter->config->font;
     
-    guint8 *y_data, *uv_data;
-    gint width, height, rowstride, uv_rowstride;
+    if (filter->atlas_opened && g_strcmp0 (font, filter->atlas_font) == 0)
+        return;
     
-    gint rect_width, rect_height, rect_x1, rect_y1, rect_x2, rect_y2, center_rect_x1, center_rect_y1;
-    gint t_square_size, square_x1, square_y1, square_x2, square_y2, center_square_x1, center_square_y1;
-    gint t_circle_radius, circle_x, circle_y;
-    gint triangle_x1, triangle_y1, triangle_x2, triangle_y2, triangle_x3, t_triangle_size, center_triangle_x1, center_triangle_y1;
+    /* The plans must not keep spans of glyphs of the old font. */
+    gst_testshape_plan_set_font (&filter->plan, NULL, 0);
+    gst_testshape_plan_set_font (&filter->roi_plan, NULL, 0);
+    if (filter->atlas != NULL)
+        gst_testshape_atlas_free (filter->atlas);
+    g_free(filter->atlas_font);
+    filter->atlas_font = g_strdup (font);
+    filter->atlas_opened = TRUE;
     
-    filter = GST_TESTSHAPE (parent);
+    filter->atlas = gst_testshape_atlas_new (font);
+    if (filter->atlas == NULL)
+        GST_WARNING_OBJECT (filter, "no font for the labels: %s", font ? font : "no default font found");
+}
+
+/* gst_testshape_build_plan compiles the current properties and the negotiated
+ * frame size into a draw plan: the resolved shapes and colors and the clipped
+ * span list sorted by row. It only runs when a property or the caps changed,
+ * every other frame just replays the cached spans.
+ */
+static void gst_testshape_build_plan (Gsttestshape * filter)
+{
+    const TestshapeConfig *config = filter->config;
+    TestshapePlan *plan = &filter->plan;
+    TestshapeShape shape;
+    TestshapeRect clip;
+    gint width, height;
     
-    /*is used to obtain the current capabilities (format and properties) of the input pad, 
-     * which represents the format of the video data that is currently being processed by the element.
+    width = GST_VIDEO_INFO_WIDTH (&GST_VIDEO_FILTER (filter)->in_info);
+    height = GST_VIDEO_INFO_HEIGHT (&GST_VIDEO_FILTER (filter)->in_info);
+    
+    g_array_set_size(plan->shapes, 0);
+    g_array_set_size(plan->points, 0);
+    g_array_set_size(plan->text, 0);
+    g_array_set_size(plan->files, 0);
+    filter->plan_valid = TRUE;
+    filter->plan_threads = config->n_threads ? config->n_threads : g_get_num_processors ();
+    
+    /* The clip rectangle applies to the shapes and to the ROI rectangles. */
+    if (gst_testshape_parse_clip (filter, &clip)) {
+        gst_testshape_plan_set_clip (plan, &clip);
+        gst_testshape_plan_set_clip (&filter->roi_plan, &clip);
+    } else {
+        gst_testshape_plan_set_clip (plan, NULL);
+        gst_testshape_plan_set_clip (&filter->roi_plan, NULL);
+    }
+    
+    /* ROI rectangles take their color, thickness and fill from the single shape
+     * properties, the shape itself is then not drawn.
      */
-    caps = gst_pad_get_current_caps (pad);
-    if (caps) {
-        if (gst_video_info_from_caps (&in_info, caps)) {
-            width = in_info.width;
-            height = in_info.height;
-            rowstride = in_info.stride[0];
-        }
-        gst_caps_unref (caps);
+    filter->plan_roi = config->roi;
+    g_hash_table_remove_all (filter->roi_color_table);
+    if (filter->plan_roi) {
+        memset(&filter->roi_shape, 0, sizeof(filter->roi_shape));
+        filter->roi_shape.type = TESTSHAPE_SHAPE_RECTANGLE;
+        filter->roi_shape.thickness = config->thickness;
+        filter->roi_shape.fill = config->fill;
+        filter->roi_shape.antialias = config->antialias;
+        if (!gst_testshape_color_parse (config->color, &filter->roi_shape.color))
+            gst_testshape_color_parse ("red", &filter->roi_shape.color);
+        gst_testshape_color_set_alpha (&filter->roi_shape.color, config->alpha);
+        gst_testshape_parse_roi_colors (filter, filter->roi_color_table);
     }
     
-    /* gst_video_frame_map function is used for mapping a video frame for efficient and safe access to its pixel data. */
-    if (gst_video_frame_map (&frame, &in_info, buf, GST_MAP_READWRITE)) {
-        y_data = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
-        uv_data = GST_VIDEO_FRAME_PLANE_DATA (&frame, 1);
-        uv_rowstride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1);
+    /* The schedule, then a shape list replace the single shape properties. */
+    if (filter->schedule != NULL)
+        gst_testshape_parse_shapes (GST_OBJECT (filter), config, filter->schedule_shapes, plan);
+    else if (config->shapes != NULL && *config->shapes != '\0')
+        gst_testshape_parse_shapes (GST_OBJECT (filter), config, config->shapes, plan);
+    else if (!filter->plan_roi && gst_testshape_property_shape (filter, &shape, width, height))
+        g_array_append_val(plan->shapes, shape);
+    
+    /* The glyphs are only loaded once some text is drawn. */
+    if (plan->text->len > 0 || (filter->plan_roi && config->roi_labels))
+        gst_testshape_update_atlas (filter);
+    gst_testshape_plan_set_font (plan, filter->atlas, config->font_size);
+    gst_testshape_plan_set_font (&filter->roi_plan, filter->atlas, config->font_size);
+    gst_testshape_plan_set_chroma_coverage (plan, config->chroma_coverage);
+    gst_testshape_plan_set_chroma_coverage (&filter->roi_plan, config->chroma_coverage);
+    
+    /* Image files are read once, stamps are converted once per size, color and
+     * format, and dropped once no plan draws them anymore.
+     */
+    gst_testshape_load_sprites (GST_OBJECT (filter), filter->sprites, plan);
+    gst_testshape_plan_set_sprites (plan, filter->sprites);
+    
+    gst_testshape_plan_rasterize (plan, width, height);
+    gst_testshape_sprites_trim (filter->sprites);
+    gst_testshape_stats_add_spans (filter->stats, plan->spans->len);
+    GST_DEBUG_OBJECT (filter, "plan of %u shapes: %u spans, %" G_GUINT64_FORMAT " pixels",
+        plan->shapes->len, plan->spans->len, plan->pixels);
+}
+
+/* Returns the label of a ROI: a "label" string in one of its parameter
+ * structures if present, the ROI type otherwise.
+ */
+static GQuark getRoiLabel(GstVideoRegionOfInterestMeta *roi)
+{
+    GList *l;
+    
+    for (l = roi->params; l != NULL; l = l->next) {
+        const gchar *label = gst_structure_get_string ((GstStructure *) l->data, "label");
         
-        /* If the user does not provide coordinates 'x' and 'y',
-         * then by default it is set to FALSE and following will be implemented.
+        if (label != NULL)
+            return g_quark_from_string (label);
+    }
+    
+    return roi->roi_type;
+}
+
+/* Returns the text written above a ROI: its label followed by the
+ * "confidence" double of its parameter structures if there is one.
+ */
+static gchar * getRoiText(GstVideoRegionOfInterestMeta *roi)
+{
+    const gchar *label = g_quark_to_string (getRoiLabel (roi));
+    gdouble confidence;
+    GList *l;
+    
+    for (l = roi->params; l != NULL; l = l->next) {
+        if (gst_structure_get_double ((GstStructure *) l->data, "confidence", &confidence))
+            return g_strdup_printf ("%s %.2f", label ? label : "", confidence);
+    }
+    
+    return g_strdup (label ? label : "");
+}
+
+/* gst_testshape_build_roi_plan turns the ROI metas of a buffer into a draw plan
+ * with one rectangle per ROI, colored by the ROI label. Returns FALSE if the
+ * buffer carries no ROI.
+ */
+static gboolean gst_testshape_build_roi_plan (Gsttestshape * filter, GstBuffer * buf)
+{
+    TestshapePlan *roi_plan = &filter->roi_plan;
+    GstVideoRegionOfInterestMeta *roi;
+    gpointer state = NULL;
+    
+    g_array_set_size(roi_plan->shapes, 0);
+    g_array_set_size(roi_plan->text, 0);
+    
+    while ((roi = (GstVideoRegionOfInterestMeta *)
+            gst_buffer_iterate_meta_filtered (buf, &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+        TestshapeShape shape = filter->roi_shape;
+        TestshapeColor *color;
+        
+        /* The rectangle is centered like the other shapes. */
+        shape.width = roi->w;
+        shape.height = roi->h;
+        shape.x = roi->x + roi->w / 2;
+        shape.y = roi->y + roi->h / 2;
+        
+        color = g_hash_table_lookup (filter->roi_color_table, GUINT_TO_POINTER (getRoiLabel (roi)));
+        if (color != NULL)
+            shape.color = *color;
+        
+        /* The glyphs of the labels come from the atlas, only the spans are
+         * built per buffer.
          */
-        if (filter->coordinate == FALSE){
-            /* Calculates the coordinates of the square */
-            t_square_size = MIN(width, height) / 4;
-            square_x1 = (width - t_square_size) / 2;
-            square_y1 = (height - t_square_size) / 2;
-            square_x2 = square_x1 + t_square_size;
-            square_y2 = square_y1 + t_square_size;
-            
-            /* Calculates the coordinates of the circle */
-            t_circle_radius = MIN(width, height) / 4;
-            circle_x = width / 2;
-            circle_y = height / 2;
-            
-            /* Calculates the coordinates of the rectangle */
-            rect_width = width / 2;
-            rect_height = height / 2;
-            rect_x1 = (width - rect_width) / 2;
-            rect_y1 = (height - rect_height) / 2;
-            rect_x2 = rect_x1 + rect_width;
-            rect_y2 = rect_y1 + rect_height;
+        if (filter->config->roi_labels) {
+            gchar *label = getRoiText (roi);
             
-            /* Calculates the coordinates of the triangle */
-            triangle_x1 = width / 2;
-            triangle_y1 = (height / 2) - 25;
-            triangle_x2 = triangle_x1 - 50;
-            triangle_y2 = triangle_y1 + 50;
-            triangle_x3 = triangle_x1 + 50;
+            gst_testshape_add_text (GST_OBJECT (filter), roi_plan, &shape, label);
+            g_free(label);
+        }
+        g_array_append_val(roi_plan->shapes, shape);
+    }
+    
+    if (roi_plan->shapes->len == 0)
+        return FALSE;
+    
+    gst_testshape_plan_rasterize (roi_plan, GST_VIDEO_INFO_WIDTH (&GST_VIDEO_FILTER (filter)->in_info),
+        GST_VIDEO_INFO_HEIGHT (&GST_VIDEO_FILTER (filter)->in_info));
+    gst_testshape_stats_add_spans (filter->stats, roi_plan->spans->len);
+    
+    return roi_plan->spans->len > 0;
+}
+
+/* gst_testshape_set_info is called by GstVideoFilter whenever new caps are
+ * negotiated. The parsed video info is cached by the base class, here the
+ * plane writer of the format is picked and the draw plan depending on the
+ * frame size is invalidated.
+ */
+static gboolean gst_testshape_set_info (GstVideoFilter * vfilter, GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (vfilter);
+    gboolean res;
+    
+    res = gst_testshape_plan_set_format (&filter->plan, GST_VIDEO_INFO_FORMAT (in_info)) &&
+        gst_testshape_plan_set_format (&filter->roi_plan, GST_VIDEO_INFO_FORMAT (in_info));
+    filter->plan_valid = FALSE;
+    filter->allocation_checked = FALSE;
+    
+    return res;
+}
+
+/* Opens the schedule file named by the schedule property when it changed.
+ * Clearing the property leaves schedule mode, the added entries included.
+ */
+static void gst_testshape_update_schedule (Gsttestshape * filter)
+{
+    const gchar *file = filter->config->schedule;
+    
+    if (file != NULL && *file == '\0')
+        file = NULL;
+    if (g_strcmp0 (file, filter->schedule_file) == 0)
+        return;
+    
+    g_free(filter->schedule_file);
+    filter->schedule_file = g_strdup (file);
+    g_free(filter->schedule_shapes);
+    filter->schedule_shapes = NULL;
+    
+    if (file == NULL) {
+        if (filter->schedule != NULL)
+            gst_testshape_schedule_free (filter->schedule);
+        filter->schedule = NULL;
+        return;
+    }
+    
+    if (filter->schedule == NULL)
+        filter->schedule = gst_testshape_schedule_new ();
+    if (!gst_testshape_schedule_load (filter->schedule, file))
+        GST_ELEMENT_WARNING (filter, RESOURCE, READ, ("Could not load overlay schedule %s", file),
+            ("the file cannot be read or its entries are not in PTS order"));
+}
+
+/* Handles the testshape-schedule custom downstream events, which add an entry
+ * to the schedule: a "pts" clock time and a "shapes" string. They are
+ * serialized, so they are handled on the streaming thread before the buffers
+ * that follow them, and are not forwarded.
+ */
+static gboolean gst_testshape_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM && gst_event_has_name (event, "testshape-schedule")) {
+        const GstStructure *structure = gst_event_get_structure (event);
+        GstClockTime pts;
+        
+        if (gst_structure_get_clock_time (structure, "pts", &pts) && GST_CLOCK_TIME_IS_VALID (pts)) {
+            if (filter->schedule == NULL)
+                filter->schedule = gst_testshape_schedule_new ();
+            gst_testshape_schedule_add (filter->schedule, pts, gst_structure_get_string (structure, "shapes"));
+        } else {
+            GST_WARNING_OBJECT (filter, "schedule event without pts: %" GST_PTR_FORMAT, event);
+        }
+        
+        gst_event_unref (event);
+        return TRUE;
+    }
+    
+    /* Frames after a flush do not repeat the ones before. */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+        gst_buffer_replace (&filter->drawn_buffer, NULL);
+    
+    return GST_BASE_TRANSFORM_CLASS (gst_testshape_parent_class)->sink_event (trans, event);
+}
+
+/* The counters start again with every run of the element. */
+static gboolean gst_testshape_start (GstBaseTransform * trans)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    
+    gst_testshape_stats_reset (filter->stats);
+    
+    return TRUE;
+}
+
+/* The pool is dropped with the buffers it holds, downstream is asked again on
+ * the next run.
+ */
+static gboolean gst_testshape_stop (GstBaseTransform * trans)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    
+    gst_testshape_release_pool (filter);
+    g_atomic_int_set (&filter->allocation_checked, FALSE);
+    
+    return TRUE;
+}
+
+/* Posts the counters as a testshape-stats element message. */
+static void gst_testshape_post_stats (Gsttestshape * filter)
+{
+    TestshapeStatsValues values;
+    GstStructure *structure;
+    
+    gst_testshape_stats_get (filter->stats, &values);
+    structure = gst_structure_new ("testshape-stats",
+        "frames", G_TYPE_UINT64, values.frames,
+        "drawn-frames", G_TYPE_UINT64, values.drawn_frames,
+        "pixels", G_TYPE_UINT64, values.pixels,
+        "spans", G_TYPE_UINT64, values.spans,
+        "draw-time-p50", G_TYPE_UINT64, values.draw_time_p50,
+        "draw-time-p99", G_TYPE_UINT64, values.draw_time_p99, NULL);
+    
+    gst_element_post_message (GST_ELEMENT (filter), gst_message_new_element (GST_OBJECT (filter), structure));
+}
+
+/* A reconfigure event means downstream may have changed, so it is asked again
+ * which metas it takes and the pool is set up again.
+ */
+static gboolean gst_testshape_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    
+    if (GST_EVENT_TYPE (event) == GST_EVENT_RECONFIGURE)
+        g_atomic_int_set (&filter->allocation_checked, FALSE);
+    
+    return GST_BASE_TRANSFORM_CLASS (gst_testshape_parent_class)->src_event (trans, event);
+}
+
+/* Returns the allocation parameters of the first allocator of an allocation
+ * query, or the default allocator, with memory aligned for the fill kernels.
+ */
+static GstAllocator * getAllocator(GstQuery *query, GstAllocationParams *params)
+{
+    GstAllocator *allocator = NULL;
+    
+    gst_allocation_params_init (params);
+    if (gst_query_get_n_allocation_params (query) > 0)
+        gst_query_parse_nth_allocation_param (query, 0, &allocator, params);
+    params->align = MAX (params->align, TESTSHAPE_POOL_ALIGN);
+    
+    return allocator;
+}
+
+/* Creates a video buffer pool of frames of caps from the answer of downstream to
+ * an allocation query: its allocator and its minimum number of buffers. Strides
+ * are padded for the fill kernels as well when downstream takes video metas.
+ */
+static GstBufferPool * gst_testshape_create_pool (Gsttestshape * filter, GstQuery * query, GstCaps * caps)
+{
+    GstVideoInfo *info = &GST_VIDEO_FILTER (filter)->out_info;
+    GstBufferPool *pool = gst_video_buffer_pool_new ();
+    GstAllocationParams params;
+    GstAllocator *allocator;
+    GstStructure *config;
+    guint size = GST_VIDEO_INFO_SIZE (info), min = 0, max = 0;
+    guint i;
+    
+    if (gst_query_get_n_allocation_pools (query) > 0)
+        gst_query_parse_nth_allocation_pool (query, 0, NULL, NULL, &min, NULL);
+    
+    allocator = getAllocator (query, &params);
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    if (allocator != NULL)
+        gst_object_unref (allocator);
+    
+    if (filter->video_meta_supported) {
+        GstVideoAlignment align;
+        
+        gst_video_alignment_reset (&align);
+        for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+            align.stride_align[i] = TESTSHAPE_POOL_ALIGN;
+        gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+        gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+        gst_buffer_pool_config_set_video_alignment (config, &align);
+    }
+    
+    /* The pool may adjust the configuration, e.g. the size for the padding. */
+    if (!gst_buffer_pool_set_config (pool, config)) {
+        config = gst_buffer_pool_get_config (pool);
+        if (!gst_buffer_pool_config_validate_params (config, caps, size, min, max) ||
+            !gst_buffer_pool_set_config (pool, config)) {
+            GST_WARNING_OBJECT (filter, "cannot configure the buffer pool");
+            gst_object_unref (pool);
+            return NULL;
+        }
+    }
+    
+    return pool;
+}
+
+/* Asks downstream with an allocation query whether it composites overlay
+ * composition metas, as textoverlay does before attaching them, and whether it
+ * takes video metas, and creates the pool frames are copied into to match.
+ */
+static void gst_testshape_query_downstream (Gsttestshape * filter)
+{
+    GstPad *srcpad = GST_BASE_TRANSFORM_SRC_PAD (filter);
+    GstCaps *caps = gst_pad_get_current_caps (srcpad);
+    GstQuery *query;
+    
+    gst_testshape_release_pool (filter);
+    filter->overlay_supported = FALSE;
+    filter->video_meta_supported = FALSE;
+    
+    if (caps == NULL)
+        return;
+    
+    query = gst_query_new_allocation (caps, TRUE);
+    if (gst_pad_peer_query (srcpad, query)) {
+        filter->overlay_supported = gst_query_find_allocation_meta (query, GST_VIDEO_OVERLAY_COMPOSITION_META_API_TYPE, NULL);
+        filter->video_meta_supported = gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+    }
+    GST_DEBUG_OBJECT (filter, "downstream %s overlay composition metas, %s video metas",
+        filter->overlay_supported ? "supports" : "does not support",
+        filter->video_meta_supported ? "supports" : "does not support");
+    
+    filter->pool = gst_testshape_create_pool (filter, query, caps);
+    
+    gst_query_unref (query);
+    gst_caps_unref (caps);
+}
+
+/* Answers the allocation query of upstream with the answer of downstream, so
+ * upstream allocates from the pools of downstream and its buffers pass through
+ * untouched. Video metas are always accepted: padded frames are drawn as they
+ * are and only repacked when downstream does not take video metas. When
+ * downstream proposes no pool, a pool of aligned video frames is proposed.
+ */
+static gboolean gst_testshape_propose_allocation (GstBaseTransform * trans, GstQuery * decide_query, GstQuery * query)
+{
+    GstAllocationParams params;
+    GstAllocator *allocator;
+    GstBufferPool *pool = NULL;
+    GstStructure *config;
+    GstVideoInfo info;
+    gboolean need_pool;
+    GstCaps *caps;
+    
+    gst_query_parse_allocation (query, &caps, &need_pool);
+    if (caps == NULL || !gst_video_info_from_caps (&info, caps))
+        return FALSE;
+    
+    if (!gst_pad_peer_query (GST_BASE_TRANSFORM_SRC_PAD (trans), query))
+        GST_DEBUG_OBJECT (trans, "downstream did not answer the allocation query");
+    
+    if (!gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL))
+        gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+    
+    if (gst_query_get_n_allocation_pools (query) > 0)
+        return TRUE;
+    
+    allocator = getAllocator (query, &params);
+    if (gst_query_get_n_allocation_params (query) == 0)
+        gst_query_add_allocation_param (query, allocator, &params);
+    
+    if (need_pool) {
+        pool = gst_video_buffer_pool_new ();
+        config = gst_buffer_pool_get_config (pool);
+        gst_buffer_pool_config_set_params (config, caps, GST_VIDEO_INFO_SIZE (&info), 0, 0);
+        gst_buffer_pool_config_set_allocator (config, allocator, &params);
+        gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+        if (!gst_buffer_pool_set_config (pool, config)) {
+            GST_WARNING_OBJECT (trans, "cannot configure the proposed buffer pool");
+            gst_object_unref (pool);
+            pool = NULL;
+        }
+    }
+    gst_query_add_allocation_pool (query, pool, GST_VIDEO_INFO_SIZE (&info), 0, 0);
+    
+    if (pool != NULL)
+        gst_object_unref (pool);
+    if (allocator != NULL)
+        gst_object_unref (allocator);
+    
+    return TRUE;
+}
+
+/* Frames keep their size and format through the element, so all metas apply to
+ * a copy of a frame except the ones describing its memory, e.g. its layout.
+ */
+static gboolean gst_testshape_transform_meta (GstBaseTransform * trans, GstBuffer * outbuf, GstMeta * meta, GstBuffer * inbuf)
+{
+    return !gst_meta_api_type_has_tag (meta->info->api, g_quark_from_static_string (GST_META_TAG_MEMORY_STR));
+}
+
+/* Renders the spans of a plan into one ARGB overlay rectangle covering the
+ * drawn pixels. Returns NULL when the plan draws nothing.
+ */
+static GstVideoOverlayRectangle * gst_testshape_render_rectangle (const TestshapePlan * plan)
+{
+    GstVideoOverlayRectangle *rectangle;
+    TestshapeRect rect;
+    GstBuffer *buffer;
+    GstMapInfo map;
+    
+    if (!gst_testshape_plan_get_extents (plan, &rect))
+        return NULL;
+    
+    buffer = gst_buffer_new_allocate (NULL, (gsize) rect.width * rect.height * 4, NULL);
+    gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+    memset(map.data, 0, map.size);
+    gst_testshape_plan_render_argb (plan, &rect, map.data, rect.width * 4);
+    gst_buffer_unmap (buffer, &map);
+    
+    gst_buffer_add_video_meta (buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_OVERLAY_COMPOSITION_FORMAT_RGB,
+        rect.width, rect.height);
+    rectangle = gst_video_overlay_rectangle_new_raw (buffer, rect.x, rect.y, rect.width, rect.height,
+        GST_VIDEO_OVERLAY_FORMAT_FLAG_NONE);
+    gst_buffer_unref (buffer);
+    
+    return rectangle;
+}
+
+/* Adds a rectangle on top of a composition, creating it if it is NULL. */
+static void addRectangle(GstVideoOverlayComposition **composition, GstVideoOverlayRectangle *rectangle)
+{
+    if (*composition == NULL)
+        *composition = gst_video_overlay_composition_new (rectangle);
+    else
+        gst_video_overlay_composition_add_rectangle (*composition, rectangle);
+}
+
+/* Attaches the shapes to a buffer as an overlay composition. The rectangle of
+ * the draw plan is rendered once per plan and shared by the buffers, the ROI
+ * rectangles are rendered per buffer. An overlay composition already on the
+ * buffer, from an upstream overlay, gets the rectangles on top of its own.
+ */
+static void gst_testshape_attach_overlay (Gsttestshape * filter, GstBuffer * buf)
+{
+    GstVideoOverlayCompositionMeta *meta;
+    GstVideoOverlayComposition *composition = NULL;
+    GstVideoOverlayRectangle *rectangle;
+    
+    if (filter->composition == NULL && filter->plan.spans->len > 0) {
+        rectangle = gst_testshape_render_rectangle (&filter->plan);
+        filter->composition = gst_video_overlay_composition_new (rectangle);
+        gst_video_overlay_rectangle_unref (rectangle);
+    }
+    
+    /* Alone, the composition of the plan is attached as is. */
+    meta = gst_buffer_get_video_overlay_composition_meta (buf);
+    if (meta == NULL && !filter->roi_plan_valid) {
+        gst_buffer_add_video_overlay_composition_meta (buf, filter->composition);
+        return;
+    }
+    
+    if (meta != NULL)
+        composition = gst_video_overlay_composition_copy (meta->overlay);
+    if (filter->composition != NULL)
+        addRectangle (&composition, gst_video_overlay_composition_get_rectangle (filter->composition, 0));
+    if (filter->roi_plan_valid) {
+        rectangle = gst_testshape_render_rectangle (&filter->roi_plan);
+        addRectangle (&composition, rectangle);
+        gst_video_overlay_rectangle_unref (rectangle);
+    }
+    
+    if (meta != NULL) {
+        gst_video_overlay_composition_unref (meta->overlay);
+        meta->overlay = composition;
+    } else {
+        gst_buffer_add_video_overlay_composition_meta (buf, composition);
+        gst_video_overlay_composition_unref (composition);
+    }
+}
+
+/* gst_testshape_before_transform runs ahead of the buffer handling of GstBaseTransform.
+ * It rebuilds the draw plan if needed and switches the element to passthrough
+ * when there is nothing to draw, so such buffers are neither mapped nor made writable.
+ */
+static void gst_testshape_before_transform (GstBaseTransform * trans, GstBuffer * buf)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    TestshapeConfig *config;
+    GstClockTime stream_time;
+    gboolean passthrough;
+    
+    /* Controlled properties take their value at the timestamp of the buffer. */
+    stream_time = gst_segment_to_stream_time (&trans->segment, GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (buf));
+    if (GST_CLOCK_TIME_IS_VALID (stream_time))
+        gst_object_sync_values (GST_OBJECT (filter), stream_time);
+    
+    gst_testshape_stats_add_frame (filter->stats);
+    
+    /* Property changes made so far apply to this frame as a whole. */
+    config = gst_testshape_take_config (filter);
+    if (config != NULL) {
+        gst_testshape_config_free (filter->config);
+        filter->config = config;
+        filter->plan_valid = FALSE;
+        gst_testshape_update_schedule (filter);
+    }
+    
+    /* In schedule mode the shapes follow the PTS of the buffers. */
+    if (filter->schedule != NULL && GST_BUFFER_PTS_IS_VALID (buf)) {
+        const gchar *shapes;
+        gboolean changed;
+        
+        shapes = gst_testshape_schedule_lookup (filter->schedule, GST_BUFFER_PTS (buf), &changed);
+        if (changed) {
+            g_free(filter->schedule_shapes);
+            filter->schedule_shapes = g_strdup (shapes);
+            filter->plan_valid = FALSE;
+        }
+    }
+    
+    /* A new plan makes the last drawn frame and the rendered overlay outdated. */
+    if (!filter->plan_valid) {
+        gst_testshape_build_plan (filter);
+        gst_buffer_replace (&filter->drawn_buffer, NULL);
+        if (filter->composition != NULL)
+            gst_video_overlay_composition_unref (filter->composition);
+        filter->composition = NULL;
+    }
+    
+    /* Downstream is asked once per caps or reconfigure which metas it takes. */
+    if (!g_atomic_int_get (&filter->allocation_checked)) {
+        g_atomic_int_set (&filter->allocation_checked, TRUE);
+        gst_testshape_query_downstream (filter);
+    }
+    filter->overlay = filter->config->overlay_meta && filter->overlay_supported;
+    
+    /* ROI rectangles come with each buffer and are rasterized per frame. */
+    filter->roi_plan_valid = filter->plan_roi && gst_testshape_build_roi_plan (filter, buf);
+    
+    passthrough = filter->plan.spans->len == 0 && !filter->roi_plan_valid;
+    if (passthrough != gst_base_transform_is_passthrough (trans))
+        gst_base_transform_set_passthrough (trans, passthrough);
+    
+    /* A GAP buffer repeats the previous frame: if that one was drawn with the
+     * same plan, the drawn frame is output again instead of drawing.
+     */
+    if (!filter->config->skip_static || passthrough || filter->roi_plan_valid || filter->overlay)
+        gst_buffer_replace (&filter->drawn_buffer, NULL);
+    filter->replay = filter->drawn_buffer != NULL && GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP);
+    
+    if (filter->config->stats_interval > 0 && ++filter->stats_frames >= filter->config->stats_interval) {
+        filter->stats_frames = 0;
+        gst_testshape_post_stats (filter);
+    }
+}
+
+/* Whether the frame of a buffer has the layout of info, without padding. */
+static gboolean hasDefaultLayout(const GstVideoInfo *info, GstBuffer *buf)
+{
+    GstVideoMeta *meta = gst_buffer_get_video_meta (buf);
+    guint i;
+    
+    if (meta == NULL)
+        return TRUE;
+    
+    for (i = 0; i < meta->n_planes; i++) {
+        if (meta->offset[i] != GST_VIDEO_INFO_PLANE_OFFSET (info, i) || meta->stride[i] != GST_VIDEO_INFO_PLANE_STRIDE (info, i))
+            return FALSE;
+    }
+    
+    return TRUE;
+}
+
+/* Adds to dst a video meta describing the same layout as the one of src, if any. */
+static void copyVideoMeta(GstBuffer *src, GstBuffer *dst)
+{
+    GstVideoMeta *meta = gst_buffer_get_video_meta (src);
+    
+    if (meta != NULL)
+        gst_buffer_add_video_meta_full (dst, meta->flags, meta->format, meta->width, meta->height,
+            meta->n_planes, meta->offset, meta->stride);
+}
+
+/* Copies the frame of inbuf into a buffer of the pool, in the layout of the
+ * pool, with the timestamps, flags and metas of inbuf. Without a usable pool
+ * the frame is copied into a new buffer in the default layout of the caps,
+ * which every downstream takes.
+ */
+static GstFlowReturn gst_testshape_copy_frame (Gsttestshape * filter, GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+    GstBaseTransform *trans = GST_BASE_TRANSFORM (filter);
+    GstVideoInfo *info = &GST_VIDEO_FILTER (filter)->in_info;
+    GstVideoFrame in_frame, out_frame;
+    GstFlowReturn ret;
+    gboolean copied;
+    
+    if (filter->pool != NULL && !gst_buffer_pool_is_active (filter->pool) &&
+        !gst_buffer_pool_set_active (filter->pool, TRUE)) {
+        GST_WARNING_OBJECT (filter, "cannot activate the buffer pool, frames are copied into new buffers");
+        gst_testshape_release_pool (filter);
+    }
+    
+    if (filter->pool != NULL) {
+        ret = gst_buffer_pool_acquire_buffer (filter->pool, outbuf, NULL);
+        if (ret != GST_FLOW_OK)
+            return ret;
+    } else {
+        *outbuf = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (info), NULL);
+        if (*outbuf == NULL) {
+            GST_ELEMENT_ERROR (filter, RESOURCE, NO_SPACE_LEFT, ("Could not copy the frame"),
+                ("failed to allocate %" G_GSIZE_FORMAT " bytes", GST_VIDEO_INFO_SIZE (info)));
+            return GST_FLOW_ERROR;
+        }
+    }
+    
+    copied = gst_video_frame_map (&in_frame, info, inbuf, GST_MAP_READ);
+    if (copied) {
+        copied = gst_video_frame_map (&out_frame, info, *outbuf, GST_MAP_WRITE);
+        if (copied) {
+            copied = gst_video_frame_copy (&out_frame, &in_frame);
+            gst_video_frame_unmap (&out_frame);
         }
+        gst_video_frame_unmap (&in_frame);
+    }
+    
+    if (!copied) {
+        GST_ELEMENT_ERROR (filter, STREAM, FAILED, ("Could not copy the frame"), ("failed to map the frame"));
+        gst_buffer_unref (*outbuf);
+        *outbuf = NULL;
+        return GST_FLOW_ERROR;
+    }
+    
+    GST_BASE_TRANSFORM_GET_CLASS (trans)->copy_metadata (trans, inbuf, *outbuf);
+    
+    return GST_FLOW_OK;
+}
+
+/* Outputs the last drawn frame with the timestamps, flags and metas of the
+ * input buffer when it is replayed, the memory of the drawn frame being shared,
+ * not copied.
+ * A frame to draw which is shared, or whose memory is read only, is copied
+ * into the pool rather than copied on write by the allocator of each memory.
+ * A frame in a padded layout downstream does not know from a video meta is
+ * always repacked, into the pool or else into a new buffer. Other frames are
+ * made writable as usual, which keeps their memory.
+ */
+static GstFlowReturn gst_testshape_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    gboolean draw, repack;
+    
+    if (filter->replay && filter->drawn_buffer != NULL) {
+        *outbuf = gst_buffer_copy_region (filter->drawn_buffer, GST_BUFFER_COPY_MEMORY, 0, -1);
+        copyVideoMeta (filter->drawn_buffer, *outbuf);
+        GST_BASE_TRANSFORM_GET_CLASS (trans)->copy_metadata (trans, inbuf, *outbuf);
+        return GST_FLOW_OK;
+    }
+    
+    draw = !gst_base_transform_is_passthrough (trans) && !filter->overlay;
+    repack = !filter->video_meta_supported && !hasDefaultLayout (&GST_VIDEO_FILTER (filter)->in_info, inbuf);
+    if (repack || (filter->pool != NULL && draw && !(gst_buffer_is_writable (inbuf) && gst_buffer_is_all_memory_writable (inbuf))))
+        return gst_testshape_copy_frame (filter, inbuf, outbuf);
+    
+    return GST_BASE_TRANSFORM_CLASS (gst_testshape_parent_class)->prepare_output_buffer (trans, inbuf, outbuf);
+}
+
+/* Skips mapping and drawing replayed frames, keeps the memory of every
+ * drawn frame in skip_static mode. In overlay mode the frame is not mapped
+ * either, only the overlay composition meta is added, so its memory stays
+ * shared with upstream.
+ */
+static GstFlowReturn gst_testshape_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (trans);
+    GstClockTime start, time;
+    GstFlowReturn ret = GST_FLOW_OK;
+    guint64 pixels = 0;
+    
+    if (filter->replay)
+        return GST_FLOW_OK;
+    
+    /* The draw time includes mapping the frame, which may copy it. */
+    start = gst_util_get_timestamp ();
+    
+    if (filter->overlay) {
+        gst_testshape_attach_overlay (filter, buf);
+    } else {
+        ret = GST_BASE_TRANSFORM_CLASS (gst_testshape_parent_class)->transform_ip (trans, buf);
+        pixels = filter->plan.pixels + (filter->roi_plan_valid ? filter->roi_plan.pixels : 0);
         
-        /* If user sets the coordinate to TRUE and provides 'x' and 'y' coordinates,
-         * then following will be implemented.
+        /* Only the memory of the frame is kept, the buffer itself goes on
+         * downstream without another reference to it.
          */
-        if (filter->coordinate == TRUE){
-            /* Calculates the coordinates of the square */
-            t_square_size = filter->square_size;
-            center_square_x1 = filter->x;
-            center_square_y1 = filter->y;
-            square_x1 = center_square_x1 - (t_square_size / 2);
-            square_y1 = center_square_y1 - (t_square_size / 2);
-            square_x2 = square_x1 + t_square_size;
-            square_y2 = square_y1 + t_square_size;
-            
-            /* Calculates the coordinates of the circle */
-            t_circle_radius = filter->circle_radius;
-            circle_x = filter->x;
-            circle_y = filter->y;
+        if (ret == GST_FLOW_OK && filter->config->skip_static && !filter->roi_plan_valid) {
+            GstBuffer *drawn = gst_buffer_copy_region (buf, GST_BUFFER_COPY_MEMORY, 0, -1);
             
-            /* Calculates the coordinates of the rectangle */
-            rect_width = filter->rect_l;
-            rect_height = filter->rect_h;
-            center_rect_x1 = filter->x;
-            center_rect_y1 = filter->y;
-            rect_x1 = center_rect_x1 - (rect_width / 2);
-            rect_y1 = center_rect_y1 - (rect_height / 2);
-            rect_x2 = rect_x1 + rect_width;
-            rect_y2 = rect_y1 + rect_height;
-            
-            /* Calculates the coordinates of the triangle */
-            t_triangle_size = filter->triangle_size;
-            center_triangle_x1 = filter->x;
-            center_triangle_y1 = filter->y;
-            triangle_x1 = center_triangle_x1;
-            triangle_y1 = center_triangle_y1 - (t_triangle_size / 2);
-            triangle_x2 = triangle_x1 - t_triangle_size;
-            triangle_y2 = triangle_y1 + t_triangle_size;
-            triangle_x3 = triangle_x1 + t_triangle_size;
+            copyVideoMeta (buf, drawn);
+            gst_buffer_replace (&filter->drawn_buffer, drawn);
+            gst_buffer_unref (drawn);
         }
+    }
+    
+    time = gst_util_get_timestamp () - start;
+    gst_testshape_stats_add_draw (filter->stats, time, pixels);
+    gst_tracer_record_log (tr_draw, GST_OBJECT_NAME (filter), time, pixels);
+    
+    return ret;
+}
+
+/* Draws one band of the frame, called on the worker threads. */
+static void gst_testshape_fill_band (gpointer data)
+{
+    TestshapeBand *band = data;
+    Gsttestshape *filter = band->filter;
+    
+    gst_testshape_plan_draw (&filter->plan, filter->fill_funcs, band->image, band->y0, band->y1);
+    
+    if (filter->roi_plan_valid)
+        gst_testshape_plan_draw (&filter->roi_plan, filter->fill_funcs, band->image, band->y0, band->y1);
+}
+
+/* gst_testshape_transform_frame_ip draws the cached draw plan into the frame,
+ * followed by the ROI rectangles of the buffer, if any.
+ * The buffer is writable by now: a shared buffer has been copied into the
+ * pool by prepare_output_buffer. Frames are mapped through their video meta,
+ * so frames with padded strides are drawn where they are.
+ * Large draws are split into bands of rows drawn in parallel by the worker pool.
+ */
+static GstFlowReturn gst_testshape_transform_frame_ip (GstVideoFilter * vfilter, GstVideoFrame * frame)
+{
+    Gsttestshape *filter = GST_TESTSHAPE (vfilter);
+    gint height = GST_VIDEO_FRAME_HEIGHT (frame);
+    guint64 pixels = filter->plan.pixels;
+    guint n_threads = filter->plan_threads;
+    guint n_bands, i;
+    TestshapeImage image;
+    TestshapeBand *bands;
+    gpointer *tasks;
+    
+    for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+        image.data[i] = GST_VIDEO_FRAME_PLANE_DATA (frame, i);
+        image.stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE (frame, i);
+    }
+    
+    if (filter->roi_plan_valid)
+        pixels += filter->roi_plan.pixels;
+    
+    /* Every band gets enough pixels to be worth a thread switch. */
+    n_bands = MIN (n_threads, pixels / TESTSHAPE_BAND_MIN_PIXELS);
+    n_bands = MIN (n_bands, (guint) (height + 1) / 2);
+    
+    if (n_bands <= 1) {
+        TestshapeBand band = { filter, &image, 0, height };
         
-		/* Define min and max coordinates for the shape */
-		int min_x, max_x, min_y, max_y;
-
-		/* Calculate min and max coordinates based on shape type. */
-		if (strcmp(filter->shape, "rectangle") == 0) {
-			// Calculate min and max coordinates for a rectangle
-			min_x = rect_x1;
-			max_x = rect_x2;
-			min_y = rect_y1;
-			max_y = rect_y2;
-		} else if (strcmp(filter->shape, "circle") == 0) {
-			// Calculate min and max coordinates for a circle
-			min_x = circle_x - t_circle_radius;
-			max_x = circle_x + t_circle_radius;
-			min_y = circle_y - t_circle_radius;
-			max_y = circle_y + t_circle_radius;
-		} else if (strcmp(filter->shape, "triangle") == 0) {
-			// Calculate min and max coordinates for a triangle
-			int min_x1 = triangle_x1 - t_triangle_size;
-			int max_x1 = triangle_x1 + t_triangle_size;
-			int min_x2 = triangle_x2 - t_triangle_size;
-			int max_x2 = triangle_x2 + t_triangle_size;
-			int min_x3 = triangle_x3 - t_triangle_size;
-			int max_x3 = triangle_x3 + t_triangle_size;
-
-			min_x = min_x1 < min_x2 ? min_x1 : min_x2;
-			min_x = min_x < min_x3 ? min_x : min_x3;
-			max_x = max_x1 > max_x2 ? max_x1 : max_x2;
-			max_x = max_x > max_x3 ? max_x : max_x3;
-
-			min_y = triangle_y1 - t_triangle_size;
-			max_y = triangle_y2 + t_triangle_size;
-		} else if (strcmp(filter->shape, "square") == 0) {
-			// Calculate min and max coordinates for a square
-			min_x = square_x1 - t_square_size / 2;
-			max_x = square_x2 + t_square_size / 2;
-			min_y = square_y1 - t_square_size / 2;
-			max_y = square_y2 + t_square_size / 2;
-		}
-
-		/* Looping over pixels for getting exact location to draw shape. */
-		for (y1 = min_y; y1 <= max_y; y1++) {
-			for (x1 = min_x; x1 <= max_x; x1++) {
-				    // Get pixels at the particular location
-				    guint8 *y_pixel = y_data + y1 * rowstride + x1;
-				    guint8 *u_pixel = uv_data + (y1 / 2) * uv_rowstride + (x1 / 2) * 2;
-				    guint8 *v_pixel = u_pixel + 1;
-
-				    /*If shape is set to rectangle, drawRectangle function is called. */
-				    if (strcmp(filter->shape, "rectangle") == 0) {
-				        drawRectangle(&frame, x1, y1, rect_width, rect_height, y_pixel, u_pixel, v_pixel, filter->color, rect_x1, rect_y1, rect_x2, rect_y2);
-				    } 
-				    /*If shape is set to circle, drawCircle function is called. */
-				    else if (strcmp(filter->shape, "circle") == 0) {
-				        drawCircle(&frame, x1, y1, t_circle_radius, y_pixel, u_pixel, v_pixel, filter->color, circle_x, circle_y);
-				    } 
-				    /*If shape is set to traingle, drawTriangle function is called.*/
-				    else if (strcmp(filter->shape, "triangle") == 0) {
-				        drawTriangle(&frame, x1, y1, t_triangle_size, y_pixel, u_pixel, v_pixel, filter->color, triangle_x1, triangle_y1, triangle_x2, triangle_y2, triangle_x3);
-				    } 
-				    /*If shape is set to square, drawSquare function is called.*/
-				    else if (strcmp(filter->shape, "square") == 0) {
-				        drawSquare(&frame, x1, y1, t_square_size, y_pixel, u_pixel, v_pixel, filter->color, square_x1, square_y1, square_x2, square_y2);
-				    }
-			}
-		}
-        
-        /* unmap the frame */
-		gst_video_frame_unmap (&frame);
+        /* Only the pixels covered by the spans are written. */
+        gst_testshape_fill_band (&band);
+        return GST_FLOW_OK;
     }
     
-    /* pushing buffer to a downstream element */
-    return gst_pad_push (filter->srcpad, buf);
+    /* The pool is persistent and only recreated when n_threads changes. */
+    if (filter->runner == NULL || gst_testshape_task_runner_get_n_threads (filter->runner) != n_threads) {
+        if (filter->runner != NULL)
+            gst_testshape_task_runner_free (filter->runner);
+        filter->runner = gst_testshape_task_runner_new (n_threads);
+    }
+    n_bands = MIN (n_bands, gst_testshape_task_runner_get_n_threads (filter->runner));
+    
+    bands = g_newa (TestshapeBand, n_bands);
+    tasks = g_newa (gpointer, n_bands);
+    
+    /* Band boundaries are rounded to even rows to keep chroma rows apart. */
+    for (i = 0; i < n_bands; i++) {
+        bands[i].filter = filter;
+        bands[i].image = &image;
+        bands[i].y0 = (gint) ((guint64) height * i / n_bands) & ~1;
+        bands[i].y1 = i + 1 < n_bands ? (gint) ((guint64) height * (i + 1) / n_bands) & ~1 : height;
+        tasks[i] = &bands[i];
+    }
+    
+    gst_testshape_task_runner_run (filter->runner, gst_testshape_fill_band, tasks, n_bands);
+    
+    return GST_FLOW_OK;
 }
 
 /* To initialize the plug-in and
@@ -628,7 +1977,9 @@ static GstFlowReturn gst_testshape_chain (GstPad * pad, GstObject * parent, GstB
  */
 static gboolean testshape_init (GstPlugin * testshape)
 {
-    return GST_ELEMENT_REGISTER (testshape, testshape);  //passes as pointer to an argument and name of element to be registered.
+    /* Passes the plugin and the name of each element to be registered. */
+    return GST_ELEMENT_REGISTER (testshape, testshape) &&
+        GST_ELEMENT_REGISTER (testshapebatch, testshape);
 }
 
 /* GST_PLUGIN_DEFINE macro is used to define a plugin and 
@@ -48,21 +48,26 @@
 #define __GST_TESTSHAPE_H__
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gsttestshapedraw.h"
+#include "gsttestshapeschedule.h"
+#include "gsttestshapestats.h"
+#include "gsttestshapetask.h"
 
 G_BEGIN_DECLS
 
 #define GST_TYPE_TESTSHAPE (gst_testshape_get_type())
 
-G_DECLARE_FINAL_TYPE (Gsttestshape, gst_testshape, GST, TESTSHAPE, GstElement)
+G_DECLARE_FINAL_TYPE (Gsttestshape, gst_testshape, GST, TESTSHAPE, GstVideoFilter)
 
 typedef struct _Gsttestshape Gsttestshape;
 
-struct _Gsttestshape
+/* Values of the element properties. */
+typedef struct
 {
-	GstElement element;
-	GstPad *sinkpad, *srcpad;
-	gchar color[10];
-	gchar shape[15];
+	gchar *shape;
+	gchar *color;
 	gint x,y;
 	gboolean coordinate;
 	gint rect_l;
@@ -70,8 +75,117 @@ struct _Gsttestshape
 	gint triangle_size;
 	gint square_size;
 	gint circle_radius;
+	gint thickness;
+	gboolean fill;
+	gchar *shapes;
+	gboolean roi;
+	gchar *roi_colors;
+	gdouble alpha;
+	guint n_threads;
+	gchar *clip;
+	gchar *schedule;
+	gboolean skip_static;
+	gboolean antialias;
+	gboolean chroma_coverage;
+	gchar *font;
+	gint font_size;
+	gboolean roi_labels;
+	gboolean overlay_meta;
+	guint stats_interval;
+} TestshapeConfig;
+
+struct _Gsttestshape
+{
+	GstVideoFilter element;
+	/* props holds the property values, guarded by the object lock. Every change
+	 * publishes a copy of them in pending_config, which the streaming thread
+	 * swaps out at the start of a frame without taking any lock. config is the
+	 * snapshot the draw plan was built from and belongs to the streaming thread.
+	 */
+	TestshapeConfig props;
+	TestshapeConfig *pending_config;
+	TestshapeConfig *config;
+	TestshapeTaskRunner *runner;
+	/* Draw plan compiled from config and the negotiated caps, rebuilt when a
+	 * new config arrives or plan_valid is cleared. plan_threads is the number
+	 * of threads a frame may be split across. In ROI mode roi_shape is the template of the ROI
+	 * rectangles, roi_color_table maps ROI labels to colors and roi_plan holds
+	 * the rectangles of the current buffer.
+	 */
+	TestshapePlan plan;
+	gboolean plan_valid;
+	guint plan_threads;
+	gboolean plan_roi;
+	TestshapeShape roi_shape;
+	GHashTable *roi_color_table;
+	TestshapePlan roi_plan;
+	gboolean roi_plan_valid;
+	/* Glyph cache of the labels, opened from atlas_font when text is first
+	 * drawn and kept until the font changes. NULL when no font could be opened.
+	 */
+	TestshapeAtlas *atlas;
+	gchar *atlas_font;
+	gboolean atlas_opened;
+	/* Image files of the sprites and their stamps, converted for the sizes,
+	 * colors and format they are drawn with.
+	 */
+	TestshapeSprites *sprites;
+	/* Overlay schedule of the streaming thread, NULL outside of schedule mode.
+	 * schedule_file is the loaded file and schedule_shapes the shapes active
+	 * at the PTS of the current buffer.
+	 */
+	TestshapeSchedule *schedule;
+	gchar *schedule_file;
+	gchar *schedule_shapes;
+	/* In skip_static mode drawn_buffer shares the memory and layout of the
+	 * last drawn frame, replay is set when the current buffer repeats it and
+	 * gets that memory as output.
+	 */
+	GstBuffer *drawn_buffer;
+	gboolean replay;
+	/* Answer of the last allocation query sent downstream, redone when
+	 * allocation_checked is cleared by new caps or a reconfigure.
+	 * overlay_supported and video_meta_supported tell whether downstream takes
+	 * overlay composition and video metas. pool is the pool frames are copied
+	 * into when they cannot be drawn in place, activated on first use.
+	 */
+	gboolean allocation_checked;
+	gboolean overlay_supported;
+	gboolean video_meta_supported;
+	GstBufferPool *pool;
+	/* In overlay_meta mode the shapes are attached to the buffers as an
+	 * overlay composition when downstream supports it, overlay being set for
+	 * the current buffer. composition holds the rendered plan until it is
+	 * rebuilt.
+	 */
+	gboolean overlay;
+	GstVideoOverlayComposition *composition;
+	/* Performance counters, readable from any thread. stats_frames counts the
+	 * frames since the last testshape-stats message.
+	 */
+	TestshapeStats *stats;
+	guint stats_frames;
+	const TestshapeFillFuncs *fill_funcs;
 };
 
+/* Sets the default property values. */
+void gst_testshape_config_init (TestshapeConfig * config);
+
+/* Frees the strings of a set of property values. */
+void gst_testshape_config_clear (TestshapeConfig * config);
+
+/* Appends the shapes of a shape list, in the syntax of the shapes property, to
+ * the shapes of a plan. Fields an entry does not give take the value of the
+ * matching property in config, invalid entries are reported on object.
+ */
+void gst_testshape_parse_shapes (GstObject * object, const TestshapeConfig * config, const gchar * str, TestshapePlan * plan);
+
+/* Loads the files of the sprite shapes of a plan into a sprite cache and
+ * resolves the sizes left out to the size of the image. Sprites whose file
+ * cannot be read are reported on object and not drawn.
+ */
+void gst_testshape_load_sprites (GstObject * object, TestshapeSprites * sprites, TestshapePlan * plan);
+
 G_END_DECLS
 
 #endif /* __GST_TESTSHAPE_H__ */
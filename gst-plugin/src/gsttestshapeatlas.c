@@ -0,0 +1,229 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Glyph atlas of testshape.
+ *
+ * The glyphs of every size are rasterized once by FreeType and appended to a
+ * single buffer of coverage masks. A hash table maps the size and character
+ * to the glyph, so laying out a label costs a lookup per character.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include "gsttestshapeatlas.h"
+
+#ifdef HAVE_FREETYPE
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#endif
+
+struct _TestshapeAtlas
+{
+#ifdef HAVE_FREETYPE
+    FT_Library library;
+    FT_Face face;
+#endif
+    gint size;
+    GArray *glyphs;
+    GHashTable *index;
+    GByteArray *masks;
+};
+
+#ifdef HAVE_FREETYPE
+
+/* Fonts tried in order when no font file is given. */
+static const gchar *default_fonts[] = {
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/TTF/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu-sans-fonts/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+    "/usr/share/fonts/liberation-sans/LiberationSans-Regular.ttf",
+};
+
+TestshapeAtlas *gst_testshape_atlas_new (const gchar * font_file)
+{
+    TestshapeAtlas *atlas = g_new0 (TestshapeAtlas, 1);
+    guint i;
+
+    if (FT_Init_FreeType (&atlas->library) != 0) {
+        g_free (atlas);
+        return NULL;
+    }
+
+    if (font_file != NULL) {
+        if (FT_New_Face (atlas->library, font_file, 0, &atlas->face) != 0)
+            atlas->face = NULL;
+    } else {
+        for (i = 0; i < G_N_ELEMENTS (default_fonts) && atlas->face == NULL; i++)
+            if (FT_New_Face (atlas->library, default_fonts[i], 0, &atlas->face) != 0)
+                atlas->face = NULL;
+    }
+
+    if (atlas->face == NULL) {
+        FT_Done_FreeType (atlas->library);
+        g_free (atlas);
+        return NULL;
+    }
+
+    atlas->glyphs = g_array_new (FALSE, FALSE, sizeof (TestshapeGlyph));
+    atlas->index = g_hash_table_new (g_direct_hash, g_direct_equal);
+    atlas->masks = g_byte_array_new ();
+
+    return atlas;
+}
+
+void gst_testshape_atlas_free (TestshapeAtlas * atlas)
+{
+    g_array_free (atlas->glyphs, TRUE);
+    g_hash_table_destroy (atlas->index);
+    g_byte_array_free (atlas->masks, TRUE);
+    FT_Done_Face (atlas->face);
+    FT_Done_FreeType (atlas->library);
+    g_free (atlas);
+}
+
+/* Selects the pixel size of the face, if it is not the current one. */
+static gboolean setSize(TestshapeAtlas *atlas, gint size)
+{
+    if (size == atlas->size)
+        return TRUE;
+
+    if (FT_Set_Pixel_Sizes (atlas->face, 0, size) != 0)
+        return FALSE;
+
+    atlas->size = size;
+    return TRUE;
+}
+
+/* Rasterizes a glyph and appends it to the atlas, returns its index or -1. */
+static gint addGlyph(TestshapeAtlas *atlas, gint size, gunichar c)
+{
+    FT_GlyphSlot slot = atlas->face->glyph;
+    TestshapeGlyph glyph;
+    gint y;
+
+    if (!setSize (atlas, size) || FT_Load_Char (atlas->face, c, FT_LOAD_RENDER) != 0 ||
+        (slot->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY && slot->bitmap.rows > 0))
+        return -1;
+
+    glyph.width = slot->bitmap.width;
+    glyph.height = slot->bitmap.rows;
+    glyph.left = slot->bitmap_left;
+    glyph.top = slot->bitmap_top;
+    glyph.advance = (gint) ((slot->advance.x + 32) >> 6);
+    glyph.offset = atlas->masks->len;
+
+    /* Rows are stored without the padding of the FreeType pitch. */
+    g_byte_array_set_size (atlas->masks, glyph.offset + (gsize) glyph.width * glyph.height);
+    for (y = 0; y < glyph.height; y++)
+        memcpy (atlas->masks->data + glyph.offset + (gsize) y * glyph.width,
+            slot->bitmap.buffer + (gssize) y * slot->bitmap.pitch, glyph.width);
+
+    g_array_append_val (atlas->glyphs, glyph);
+    return atlas->glyphs->len - 1;
+}
+
+const TestshapeGlyph *gst_testshape_atlas_get_glyph (TestshapeAtlas * atlas, gint size, gunichar c)
+{
+    gpointer key, value;
+    gint index;
+
+    if (size <= 0 || size > TESTSHAPE_ATLAS_MAX_SIZE || c > 0x10FFFF)
+        return NULL;
+
+    /* 21 bits hold any character, the size goes above them. */
+    key = GUINT_TO_POINTER (((guint) size << 21) | c);
+    if (g_hash_table_lookup_extended (atlas->index, key, NULL, &value)) {
+        index = GPOINTER_TO_INT (value);
+    } else {
+        index = addGlyph (atlas, size, c);
+        g_hash_table_insert (atlas->index, key, GINT_TO_POINTER (index));
+    }
+
+    return index < 0 ? NULL : &g_array_index (atlas->glyphs, TestshapeGlyph, index);
+}
+
+void gst_testshape_atlas_get_metrics (TestshapeAtlas * atlas, gint size, gint * ascent, gint * height)
+{
+    *ascent = size;
+    *height = size;
+
+    if (size <= 0 || size > TESTSHAPE_ATLAS_MAX_SIZE || !setSize (atlas, size))
+        return;
+
+    *ascent = (gint) ((atlas->face->size->metrics.ascender + 32) >> 6);
+    *height = (gint) ((atlas->face->size->metrics.ascender - atlas->face->size->metrics.descender + 32) >> 6);
+}
+
+#else
+
+TestshapeAtlas *gst_testshape_atlas_new (const gchar * font_file)
+{
+    return NULL;
+}
+
+void gst_testshape_atlas_free (TestshapeAtlas * atlas)
+{
+}
+
+const TestshapeGlyph *gst_testshape_atlas_get_glyph (TestshapeAtlas * atlas, gint size, gunichar c)
+{
+    return NULL;
+}
+
+void gst_testshape_atlas_get_metrics (TestshapeAtlas * atlas, gint size, gint * ascent, gint * height)
+{
+    *ascent = size;
+    *height = size;
+}
+
+#endif
+
+const guint8 *gst_testshape_atlas_get_mask (const TestshapeAtlas * atlas, const TestshapeGlyph * glyph)
+{
+    return atlas->masks->data + glyph->offset;
+}
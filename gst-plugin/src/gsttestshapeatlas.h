@@ -0,0 +1,94 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_ATLAS_H__
+#define __GST_TESTSHAPE_ATLAS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Glyph cache for text labels.
+ * Glyphs are rasterized by FreeType the first time they are used at a size
+ * and kept as 8 bit coverage masks packed in one buffer, so drawing text
+ * afterwards only copies cached coverage. There is no shaping: text is laid
+ * out glyph by glyph along the advances.
+ */
+typedef struct _TestshapeAtlas TestshapeAtlas;
+
+/* Largest pixel size of a glyph, sizes and characters share the cache key. */
+#define TESTSHAPE_ATLAS_MAX_SIZE 2047
+
+/* A cached glyph. Its mask of width x height coverage values starts at offset
+ * in the atlas, left and top place it relative to the pen position on the
+ * baseline, top going up. advance is the pen move to the next glyph.
+ */
+typedef struct
+{
+	gint width, height;
+	gint left, top;
+	gint advance;
+	gsize offset;
+} TestshapeGlyph;
+
+/* Opens a font file, or the first default font found when font_file is NULL.
+ * Returns NULL if no font can be opened or the plugin is built without FreeType.
+ */
+TestshapeAtlas *gst_testshape_atlas_new (const gchar * font_file);
+
+void gst_testshape_atlas_free (TestshapeAtlas * atlas);
+
+/* Returns the glyph of character c at a pixel size, rasterizing it on first use.
+ * The pointer is valid until the next call, NULL if the glyph cannot be rendered.
+ */
+const TestshapeGlyph *gst_testshape_atlas_get_glyph (TestshapeAtlas * atlas, gint size, gunichar c);
+
+/* Returns the coverage mask of a glyph, rows of glyph->width values. */
+const guint8 *gst_testshape_atlas_get_mask (const TestshapeAtlas * atlas, const TestshapeGlyph * glyph);
+
+/* Gets the distance from the top of a line to the baseline and the line height at a pixel size. */
+void gst_testshape_atlas_get_metrics (TestshapeAtlas * atlas, gint size, gint * ascent, gint * height);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_ATLAS_H__ */
@@ -0,0 +1,723 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-testshapebatch
+ *
+ * Draws shapes on many video streams with one element. Each sink_%u request
+ * pad gets a matching src_%u pad and its own shape list, set with the shapes
+ * property of the sink pad in the syntax of the testshape shapes property.
+ *
+ * Instead of every streaming thread drawing its own frame, the frames are
+ * queued and drawn together: the streaming thread that completes a batch,
+ * or finds its timeout expired, draws all queued frames on a worker pool of
+ * n_threads threads while the others wait, then every thread pushes its own
+ * frame. Overlay drawing of all the streams thus shares one thread budget.
+ *
+ * gst-launch-1.0 testshapebatch name=b sink_0::shapes="circle, x=100, y=100, radius=50" \
+ *   sink_1::shapes="rectangle, x=200, y=100, width=80, height=60, color=green" \
+ *   videotestsrc ! video/x-raw, format=NV12 ! b.sink_0  b.src_0 ! autovideosink \
+ *   videotestsrc pattern=ball ! video/x-raw, format=NV12 ! b.sink_1  b.src_1 ! autovideosink
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gsttestshapebatch.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_testshape_batch_debug);
+#define GST_CAT_DEFAULT gst_testshape_batch_debug
+
+enum
+{
+	PROP_0,
+	PROP_N_THREADS,
+	PROP_TIMEOUT,
+};
+
+enum
+{
+	PROP_PAD_0,
+	PROP_PAD_SHAPES,
+};
+
+/* A frame queued for the batch, it lives on the stack of its streaming thread. */
+typedef struct
+{
+    GsttestshapeBatchPad *pad;
+    GstVideoFrame frame;
+    TestshapeImage image;
+    gboolean done;
+} TestshapeBatchItem;
+
+/* A run of queued frames drawn by one thread of the pool. */
+typedef struct
+{
+    GsttestshapeBatch *batch;
+    TestshapeBatchItem **items;
+    guint n_items;
+} TestshapeBatchTask;
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("video/x-raw, format=(string)" TESTSHAPE_WRITER_FORMATS ", width=(int)[1, 3840], height=(int)[1, 2160], framerate=" GST_VIDEO_FPS_RANGE)
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("video/x-raw, format=(string)" TESTSHAPE_WRITER_FORMATS ", width=(int)[1, 3840], height=(int)[1, 2160], framerate=" GST_VIDEO_FPS_RANGE)
+    );
+
+G_DEFINE_TYPE (GsttestshapeBatchPad, gst_testshape_batch_pad, GST_TYPE_PAD);
+
+G_DEFINE_TYPE (GsttestshapeBatch, gst_testshape_batch, GST_TYPE_ELEMENT);
+
+GST_ELEMENT_REGISTER_DEFINE (testshapebatch, "testshapebatch", GST_RANK_NONE, GST_TYPE_TESTSHAPE_BATCH);
+
+static void gst_testshape_batch_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_testshape_batch_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
+static void gst_testshape_batch_finalize (GObject * object);
+static GstPad *gst_testshape_batch_request_new_pad (GstElement * element, GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_testshape_batch_release_pad (GstElement * element, GstPad * pad);
+
+/* Shape list of a sink pad. */
+static void gst_testshape_batch_pad_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (object);
+
+    switch (prop_id) {
+        case PROP_PAD_SHAPES:
+            GST_OBJECT_LOCK (pad);
+            g_free(pad->shapes);
+            pad->shapes = g_value_dup_string(value);
+            pad->changed = TRUE;
+            GST_OBJECT_UNLOCK (pad);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void gst_testshape_batch_pad_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (object);
+
+    switch (prop_id) {
+        case PROP_PAD_SHAPES:
+            GST_OBJECT_LOCK (pad);
+            g_value_set_string(value, pad->shapes);
+            GST_OBJECT_UNLOCK (pad);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void gst_testshape_batch_pad_finalize (GObject * object)
+{
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (object);
+
+    g_free(pad->shapes);
+    gst_testshape_plan_clear (&pad->plan);
+
+    G_OBJECT_CLASS (gst_testshape_batch_pad_parent_class)->finalize (object);
+}
+
+static void gst_testshape_batch_pad_class_init (GsttestshapeBatchPadClass * klass)
+{
+    GObjectClass *gobject_class = (GObjectClass *) klass;
+
+    gobject_class->set_property = gst_testshape_batch_pad_set_property;
+    gobject_class->get_property = gst_testshape_batch_pad_get_property;
+    gobject_class->finalize = gst_testshape_batch_pad_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_PAD_SHAPES,
+        g_param_spec_string("shapes", "Shapes", "Shapes drawn on the stream of the pad, in the syntax of the testshape "
+            "shapes property", NULL, G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING));
+}
+
+static void gst_testshape_batch_pad_init (GsttestshapeBatchPad * pad)
+{
+    pad->srcpad = NULL;
+    pad->shapes = NULL;
+    pad->changed = FALSE;
+    gst_video_info_init (&pad->info);
+    pad->info_valid = FALSE;
+    gst_testshape_plan_init (&pad->plan);
+    pad->plan_valid = FALSE;
+    pad->active = FALSE;
+    pad->idle = FALSE;
+    pad->flushing = FALSE;
+}
+
+static void gst_testshape_batch_class_init (GsttestshapeBatchClass * klass)
+{
+    GObjectClass *gobject_class = (GObjectClass *) klass;
+    GstElementClass *gstelement_class = (GstElementClass *) klass;
+
+    gobject_class->set_property = gst_testshape_batch_set_property;
+    gobject_class->get_property = gst_testshape_batch_get_property;
+    gobject_class->finalize = gst_testshape_batch_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_N_THREADS,
+        g_param_spec_uint("n_threads", "N_threads", "Number of threads drawing a batch, shared by all the streams, "
+            "0 uses one per CPU", 0, G_MAXUINT, 1, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_TIMEOUT,
+        g_param_spec_uint64("timeout", "Timeout", "Longest time in nanoseconds a frame waits for the frames of the "
+            "other streams before the batch is drawn without them", 0, G_MAXUINT64, 5 * GST_MSECOND, G_PARAM_READWRITE));
+
+    GST_DEBUG_CATEGORY_INIT (gst_testshape_batch_debug, "testshapebatch", 0, "testshape batched drawing");
+
+    gst_element_class_set_static_metadata (gstelement_class,
+        "testshapebatch",
+        "Filter/Effect/Video",
+        "Draws shapes on several video streams in batches",
+        "Vinay Kesarwani vinay.kesarwani@softnautics.com");
+
+    gst_element_class_add_static_pad_template_with_gtype (gstelement_class, &sink_factory, GST_TYPE_TESTSHAPE_BATCH_PAD);
+    gst_element_class_add_static_pad_template (gstelement_class, &src_factory);
+
+    gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR (gst_testshape_batch_request_new_pad);
+    gstelement_class->release_pad = GST_DEBUG_FUNCPTR (gst_testshape_batch_release_pad);
+}
+
+static void gst_testshape_batch_init (GsttestshapeBatch * batch)
+{
+    g_mutex_init (&batch->lock);
+    g_cond_init (&batch->cond);
+    g_queue_init (&batch->pending);
+    batch->deadline = 0;
+    batch->drawing = FALSE;
+    batch->n_active = 0;
+    batch->n_pads = 0;
+    batch->n_threads = 1;
+    batch->timeout = 5 * GST_MSECOND;
+    batch->runner = NULL;
+    batch->fill_funcs = gst_testshape_fill_get_funcs ();
+    gst_testshape_config_init (&batch->defaults);
+    g_mutex_init (&batch->cache_lock);
+    batch->atlas = NULL;
+    batch->atlas_opened = FALSE;
+    batch->sprites = gst_testshape_sprites_new ();
+}
+
+static void gst_testshape_batch_finalize (GObject * object)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (object);
+
+    if (batch->runner != NULL)
+        gst_testshape_task_runner_free (batch->runner);
+    if (batch->atlas != NULL)
+        gst_testshape_atlas_free (batch->atlas);
+    gst_testshape_sprites_free (batch->sprites);
+    gst_testshape_config_clear (&batch->defaults);
+    g_mutex_clear (&batch->cache_lock);
+    g_cond_clear (&batch->cond);
+    g_mutex_clear (&batch->lock);
+
+    G_OBJECT_CLASS (gst_testshape_batch_parent_class)->finalize (object);
+}
+
+static void gst_testshape_batch_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (object);
+
+    GST_OBJECT_LOCK (batch);
+    switch (prop_id) {
+        case PROP_N_THREADS:
+            batch->n_threads = g_value_get_uint(value);
+            break;
+        case PROP_TIMEOUT:
+            batch->timeout = g_value_get_uint64(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (batch);
+}
+
+static void gst_testshape_batch_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (object);
+
+    GST_OBJECT_LOCK (batch);
+    switch (prop_id) {
+        case PROP_N_THREADS:
+            g_value_set_uint(value, batch->n_threads);
+            break;
+        case PROP_TIMEOUT:
+            g_value_set_uint64(value, batch->timeout);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (batch);
+}
+
+/* Changes the state of a stream, called with the lock held. Batches wait
+ * for the frames of active streams that are not idle, the waiting threads
+ * check again if their batch is now complete.
+ */
+static void setState(GsttestshapeBatch *batch, GsttestshapeBatchPad *pad, gboolean active, gboolean idle)
+{
+    gboolean waited = pad->active && !pad->idle;
+
+    pad->active = active;
+    pad->idle = idle;
+    if (waited == (active && !idle))
+        return;
+
+    if (waited)
+        batch->n_active--;
+    else
+        batch->n_active++;
+    g_cond_broadcast (&batch->cond);
+}
+
+static void setActive(GsttestshapeBatch *batch, GsttestshapeBatchPad *pad, gboolean active)
+{
+    setState (batch, pad, active, pad->idle);
+}
+
+/* Builds the draw plan of a stream from its shape list and frame size. Plans
+ * with text or sprites are rasterized under the cache lock, the glyph and
+ * sprite caches being shared.
+ */
+static void gst_testshape_batch_build_plan (GsttestshapeBatch * batch, GsttestshapeBatchPad * pad)
+{
+    TestshapePlan *plan = &pad->plan;
+    gchar *shapes;
+
+    GST_OBJECT_LOCK (pad);
+    shapes = g_strdup (pad->shapes);
+    pad->changed = FALSE;
+    GST_OBJECT_UNLOCK (pad);
+
+    g_array_set_size(plan->shapes, 0);
+    g_array_set_size(plan->points, 0);
+    g_array_set_size(plan->text, 0);
+    g_array_set_size(plan->files, 0);
+    gst_testshape_parse_shapes (GST_OBJECT (pad), &batch->defaults, shapes, plan);
+    g_free(shapes);
+
+    if (plan->text->len == 0 && plan->files->len == 0) {
+        gst_testshape_plan_rasterize (plan, GST_VIDEO_INFO_WIDTH (&pad->info), GST_VIDEO_INFO_HEIGHT (&pad->info));
+    } else {
+        g_mutex_lock (&batch->cache_lock);
+        if (plan->text->len > 0 && !batch->atlas_opened) {
+            batch->atlas = gst_testshape_atlas_new (NULL);
+            batch->atlas_opened = TRUE;
+            if (batch->atlas == NULL)
+                GST_WARNING_OBJECT (batch, "no font for the labels");
+        }
+        gst_testshape_plan_set_font (plan, batch->atlas, batch->defaults.font_size);
+        gst_testshape_load_sprites (GST_OBJECT (pad), batch->sprites, plan);
+        gst_testshape_plan_set_sprites (plan, batch->sprites);
+        gst_testshape_plan_rasterize (plan, GST_VIDEO_INFO_WIDTH (&pad->info), GST_VIDEO_INFO_HEIGHT (&pad->info));
+        gst_testshape_sprites_trim (batch->sprites);
+        g_mutex_unlock (&batch->cache_lock);
+    }
+
+    pad->plan_valid = TRUE;
+    GST_DEBUG_OBJECT (pad, "plan of %u shapes: %u spans", plan->shapes->len, plan->spans->len);
+}
+
+/* Draws a run of queued frames, called on the threads of the pool. */
+static void gst_testshape_batch_draw_task (gpointer data)
+{
+    TestshapeBatchTask *task = data;
+    guint i;
+
+    for (i = 0; i < task->n_items; i++) {
+        TestshapeBatchItem *item = task->items[i];
+
+        gst_testshape_plan_draw (&item->pad->plan, task->batch->fill_funcs, &item->image, 0,
+            GST_VIDEO_FRAME_HEIGHT (&item->frame));
+    }
+}
+
+/* Draws the queued frames, called without the lock by the only thread drawing.
+ * The frames are split into runs of about the same number of pixels, one per
+ * thread of the pool.
+ */
+static void gst_testshape_batch_draw (GsttestshapeBatch * batch, TestshapeBatchItem ** items, guint n_items)
+{
+    TestshapeBatchTask *tasks;
+    gpointer *task_list;
+    guint64 total = 0, sum = 0;
+    guint n_threads, n_tasks = 0, first = 0, i;
+
+    GST_OBJECT_LOCK (batch);
+    n_threads = batch->n_threads ? batch->n_threads : g_get_num_processors ();
+    GST_OBJECT_UNLOCK (batch);
+
+    /* The pool is persistent and only recreated when n_threads changes. */
+    if (batch->runner == NULL || gst_testshape_task_runner_get_n_threads (batch->runner) != n_threads) {
+        if (batch->runner != NULL)
+            gst_testshape_task_runner_free (batch->runner);
+        batch->runner = gst_testshape_task_runner_new (n_threads);
+    }
+    n_threads = MIN (gst_testshape_task_runner_get_n_threads (batch->runner), n_items);
+
+    tasks = g_newa (TestshapeBatchTask, n_threads);
+    task_list = g_newa (gpointer, n_threads);
+
+    for (i = 0; i < n_items; i++)
+        total += items[i]->pad->plan.pixels + 1;
+
+    /* A run ends once it reaches its share of the pixels. */
+    for (i = 0; i < n_items; i++) {
+        sum += items[i]->pad->plan.pixels + 1;
+        if (sum * n_threads >= total * (n_tasks + 1) || i + 1 == n_items) {
+            tasks[n_tasks].batch = batch;
+            tasks[n_tasks].items = items + first;
+            tasks[n_tasks].n_items = i + 1 - first;
+            task_list[n_tasks] = &tasks[n_tasks];
+            n_tasks++;
+            first = i + 1;
+        }
+    }
+
+    GST_LOG_OBJECT (batch, "drawing %u frames with %u threads", n_items, n_tasks);
+    gst_testshape_task_runner_run (batch->runner, gst_testshape_batch_draw_task, task_list, n_tasks);
+}
+
+/* Queues a frame and waits until a batch including it was drawn, called with
+ * the lock held. The thread finding the batch complete, or its deadline
+ * passed, draws it. Returns FALSE if the stream started flushing before.
+ */
+static gboolean gst_testshape_batch_wait (GsttestshapeBatch * batch, TestshapeBatchItem * item)
+{
+    GsttestshapeBatchPad *pad = item->pad;
+
+    g_queue_push_tail (&batch->pending, item);
+    if (batch->pending.length == 1) {
+        GST_OBJECT_LOCK (batch);
+        batch->deadline = g_get_monotonic_time () + batch->timeout / GST_USECOND;
+        GST_OBJECT_UNLOCK (batch);
+    }
+
+    while (!item->done) {
+        if (pad->flushing && g_queue_remove (&batch->pending, item))
+            return FALSE;
+
+        if (!batch->drawing && batch->pending.length > 0 &&
+            (batch->pending.length >= batch->n_active || g_get_monotonic_time () >= batch->deadline)) {
+            TestshapeBatchItem **items;
+            guint n_items = batch->pending.length, i;
+
+            /* Take the whole queue, frames arriving meanwhile start the next batch. */
+            items = g_newa (TestshapeBatchItem *, n_items);
+            for (i = 0; i < n_items; i++)
+                items[i] = g_queue_pop_head (&batch->pending);
+            batch->drawing = TRUE;
+            g_mutex_unlock (&batch->lock);
+
+            gst_testshape_batch_draw (batch, items, n_items);
+
+            g_mutex_lock (&batch->lock);
+            for (i = 0; i < n_items; i++)
+                items[i]->done = TRUE;
+            batch->drawing = FALSE;
+            g_cond_broadcast (&batch->cond);
+            continue;
+        }
+
+        if (batch->drawing)
+            g_cond_wait (&batch->cond, &batch->lock);
+        else
+            g_cond_wait_until (&batch->cond, &batch->lock, batch->deadline);
+    }
+
+    return TRUE;
+}
+
+/* Draws the plan of the stream into a frame as part of a batch and pushes it
+ * on the src pad of the stream, from the streaming thread of the stream.
+ */
+static GstFlowReturn gst_testshape_batch_chain (GstPad * sinkpad, GstObject * parent, GstBuffer * buf)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (parent);
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (sinkpad);
+    TestshapeBatchItem item;
+    gboolean changed, drawn;
+    guint i;
+
+    if (!pad->info_valid) {
+        gst_buffer_unref (buf);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    GST_OBJECT_LOCK (pad);
+    changed = pad->changed;
+    GST_OBJECT_UNLOCK (pad);
+    /* Batches stop waiting for a stream with nothing to draw until its plan
+     * draws something again, its frames are not queued.
+     */
+    if (changed || !pad->plan_valid) {
+        gst_testshape_batch_build_plan (batch, pad);
+        g_mutex_lock (&batch->lock);
+        setState (batch, pad, pad->active, pad->plan.spans->len == 0);
+        g_mutex_unlock (&batch->lock);
+    }
+
+    if (pad->plan.spans->len == 0)
+        return gst_pad_push (pad->srcpad, buf);
+
+    buf = gst_buffer_make_writable (buf);
+    if (!gst_video_frame_map (&item.frame, &pad->info, buf, GST_MAP_READWRITE)) {
+        GST_ELEMENT_ERROR (batch, CORE, FAILED, (NULL), ("could not map the frame"));
+        gst_buffer_unref (buf);
+        return GST_FLOW_ERROR;
+    }
+    item.pad = pad;
+    item.done = FALSE;
+    for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (&item.frame); i++) {
+        item.image.data[i] = GST_VIDEO_FRAME_PLANE_DATA (&item.frame, i);
+        item.image.stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE (&item.frame, i);
+    }
+
+    g_mutex_lock (&batch->lock);
+    drawn = !pad->flushing && gst_testshape_batch_wait (batch, &item);
+    g_mutex_unlock (&batch->lock);
+
+    gst_video_frame_unmap (&item.frame);
+
+    if (!drawn) {
+        gst_buffer_unref (buf);
+        return GST_FLOW_FLUSHING;
+    }
+
+    return gst_pad_push (pad->srcpad, buf);
+}
+
+/* Keeps track of the streams a batch waits for and of the caps of the stream,
+ * the events themselves go on to the src pad.
+ */
+static gboolean gst_testshape_batch_sink_event (GstPad * sinkpad, GstObject * parent, GstEvent * event)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (parent);
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (sinkpad);
+
+    switch (GST_EVENT_TYPE (event)) {
+        case GST_EVENT_CAPS:
+        {
+            GstCaps *caps;
+
+            gst_event_parse_caps (event, &caps);
+            if (!gst_video_info_from_caps (&pad->info, caps) ||
+                !gst_testshape_plan_set_format (&pad->plan, GST_VIDEO_INFO_FORMAT (&pad->info))) {
+                gst_event_unref (event);
+                return FALSE;
+            }
+            pad->info_valid = TRUE;
+            pad->plan_valid = FALSE;
+            break;
+        }
+        case GST_EVENT_FLUSH_START:
+            g_mutex_lock (&batch->lock);
+            pad->flushing = TRUE;
+            setActive (batch, pad, FALSE);
+            g_mutex_unlock (&batch->lock);
+            break;
+        case GST_EVENT_FLUSH_STOP:
+        case GST_EVENT_STREAM_START:
+            g_mutex_lock (&batch->lock);
+            pad->flushing = FALSE;
+            setActive (batch, pad, TRUE);
+            g_mutex_unlock (&batch->lock);
+            break;
+        case GST_EVENT_EOS:
+            /* Batches no longer wait for a stream that ended. */
+            g_mutex_lock (&batch->lock);
+            setActive (batch, pad, FALSE);
+            g_mutex_unlock (&batch->lock);
+            break;
+        default:
+            break;
+    }
+
+    return gst_pad_event_default (sinkpad, parent, event);
+}
+
+/* Frames may wait up to the timeout for their batch, which adds to the latency. */
+static gboolean gst_testshape_batch_src_query (GstPad * srcpad, GstObject * parent, GstQuery * query)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (parent);
+    GstClockTime min, max, timeout;
+    gboolean live;
+
+    if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+        return gst_pad_query_default (srcpad, parent, query);
+    
+    if (!gst_pad_query_default (srcpad, parent, query))
+        return FALSE;
+
+    GST_OBJECT_LOCK (batch);
+    timeout = batch->timeout;
+    GST_OBJECT_UNLOCK (batch);
+
+    gst_query_parse_latency (query, &live, &min, &max);
+    min += timeout;
+    if (GST_CLOCK_TIME_IS_VALID (max))
+        max += timeout;
+    gst_query_set_latency (query, live, min, max);
+
+    return TRUE;
+}
+
+/* A stream going down stops flushing waiting frames, so that deactivating
+ * the pad does not wait for a batch.
+ */
+static gboolean gst_testshape_batch_sink_activate_mode (GstPad * sinkpad, GstObject * parent, GstPadMode mode, gboolean active)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (parent);
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (sinkpad);
+
+    if (mode != GST_PAD_MODE_PUSH)
+        return FALSE;
+
+    g_mutex_lock (&batch->lock);
+    pad->flushing = !active;
+    setActive (batch, pad, active);
+    g_mutex_unlock (&batch->lock);
+
+    return TRUE;
+}
+
+/* The sink and src pads of a stream are linked to each other. */
+static GstIterator * gst_testshape_batch_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+    GstPad *other = GST_PAD_IS_SINK (pad) ? GST_TESTSHAPE_BATCH_PAD (pad)->srcpad : GST_PAD (GST_PAD_ELEMENT_PRIVATE (pad));
+    GstIterator *it;
+    GValue value = G_VALUE_INIT;
+
+    if (other == NULL)
+        return NULL;
+
+    g_value_init (&value, GST_TYPE_PAD);
+    g_value_set_object (&value, other);
+    it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+    g_value_unset (&value);
+
+    return it;
+}
+
+/* Creates the sink pad of a new stream and its src pad with the same number. */
+static GstPad * gst_testshape_batch_request_new_pad (GstElement * element, GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (element);
+    GsttestshapeBatchPad *pad;
+    GstPad *srcpad;
+    gchar *sinkname, *srcname;
+    guint index;
+
+    GST_OBJECT_LOCK (batch);
+    if (name == NULL || sscanf (name, "sink_%u", &index) != 1)
+        index = batch->n_pads;
+    batch->n_pads = MAX (batch->n_pads, index + 1);
+    GST_OBJECT_UNLOCK (batch);
+
+    /* Pads requested by template are named after the number they get too. */
+    sinkname = g_strdup_printf ("sink_%u", index);
+    srcname = g_strdup_printf ("src_%u", index);
+    srcpad = gst_element_get_static_pad (element, srcname);
+    if (srcpad != NULL) {
+        GST_WARNING_OBJECT (batch, "stream %u already exists", index);
+        gst_object_unref (srcpad);
+        g_free(sinkname);
+        g_free(srcname);
+        return NULL;
+    }
+
+    pad = g_object_new (GST_TYPE_TESTSHAPE_BATCH_PAD, "name", sinkname, "direction", GST_PAD_SINK, "template", templ, NULL);
+    srcpad = gst_pad_new_from_static_template (&src_factory, srcname);
+    g_free(sinkname);
+    g_free(srcname);
+    pad->srcpad = srcpad;
+    GST_PAD_ELEMENT_PRIVATE (srcpad) = pad;
+
+    gst_pad_set_chain_function (GST_PAD (pad), GST_DEBUG_FUNCPTR (gst_testshape_batch_chain));
+    gst_pad_set_event_function (GST_PAD (pad), GST_DEBUG_FUNCPTR (gst_testshape_batch_sink_event));
+    gst_pad_set_activatemode_function (GST_PAD (pad), GST_DEBUG_FUNCPTR (gst_testshape_batch_sink_activate_mode));
+    gst_pad_set_iterate_internal_links_function (GST_PAD (pad), GST_DEBUG_FUNCPTR (gst_testshape_batch_iterate_internal_links));
+    gst_pad_set_iterate_internal_links_function (srcpad, GST_DEBUG_FUNCPTR (gst_testshape_batch_iterate_internal_links));
+    gst_pad_set_query_function (srcpad, GST_DEBUG_FUNCPTR (gst_testshape_batch_src_query));
+    GST_PAD_SET_PROXY_CAPS (GST_PAD (pad));
+    GST_PAD_SET_PROXY_ALLOCATION (GST_PAD (pad));
+    GST_PAD_SET_PROXY_CAPS (srcpad);
+    GST_PAD_SET_PROXY_ALLOCATION (srcpad);
+
+    /* The src pad exists before data can flow through the sink pad. */
+    gst_element_add_pad (element, srcpad);
+    gst_element_add_pad (element, GST_PAD (pad));
+
+    return GST_PAD (pad);
+}
+
+/* Removes a stream, batches stop waiting for it. */
+static void gst_testshape_batch_release_pad (GstElement * element, GstPad * sinkpad)
+{
+    GsttestshapeBatch *batch = GST_TESTSHAPE_BATCH (element);
+    GsttestshapeBatchPad *pad = GST_TESTSHAPE_BATCH_PAD (sinkpad);
+    GstPad *srcpad = pad->srcpad;
+
+    g_mutex_lock (&batch->lock);
+    pad->flushing = TRUE;
+    setActive (batch, pad, FALSE);
+    g_mutex_unlock (&batch->lock);
+
+    gst_element_remove_pad (element, sinkpad);
+    gst_element_remove_pad (element, srcpad);
+}
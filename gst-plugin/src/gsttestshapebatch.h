@@ -0,0 +1,128 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_BATCH_H__
+#define __GST_TESTSHAPE_BATCH_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gsttestshape.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_TESTSHAPE_BATCH_PAD (gst_testshape_batch_pad_get_type())
+
+G_DECLARE_FINAL_TYPE (GsttestshapeBatchPad, gst_testshape_batch_pad, GST, TESTSHAPE_BATCH_PAD, GstPad)
+
+#define GST_TYPE_TESTSHAPE_BATCH (gst_testshape_batch_get_type())
+
+G_DECLARE_FINAL_TYPE (GsttestshapeBatch, gst_testshape_batch, GST, TESTSHAPE_BATCH, GstElement)
+
+/* Sink pad of one stream, paired with srcpad. */
+struct _GsttestshapeBatchPad
+{
+	GstPad pad;
+	GstPad *srcpad;
+	/* Shape list of the stream, guarded by the object lock. changed is set
+	 * when it was replaced since the plan was last built.
+	 */
+	gchar *shapes;
+	gboolean changed;
+	/* Draw plan of the stream, built on its streaming thread from shapes and
+	 * the negotiated info. plan_valid is cleared by new shapes or caps.
+	 */
+	GstVideoInfo info;
+	gboolean info_valid;
+	TestshapePlan plan;
+	gboolean plan_valid;
+	/* Guarded by the lock of the element: active streams are waited for to
+	 * complete a batch, unless idle, their plan drawing nothing, and
+	 * flushing ones do not queue frames.
+	 */
+	gboolean active;
+	gboolean idle;
+	gboolean flushing;
+};
+
+/* Draws the shapes of N streams, each going from a sink_%u request pad to the
+ * matching src_%u pad. Frames of all the streams are queued and drawn
+ * together as one batch on a shared worker pool.
+ */
+struct _GsttestshapeBatch
+{
+	GstElement element;
+	/* lock guards the queued frames, the stream states and the batch: a
+	 * batch is drawn once the n_active streams waited for have queued a
+	 * frame, or when deadline passes, by the streaming thread that finds it
+	 * ready. drawing is set while that thread draws, cond is signalled when
+	 * it is done and when the streams change.
+	 */
+	GMutex lock;
+	GCond cond;
+	GQueue pending;
+	gint64 deadline;
+	gboolean drawing;
+	guint n_active;
+	guint n_pads;
+	/* Properties, guarded by the object lock. */
+	guint n_threads;
+	GstClockTime timeout;
+	/* Worker pool, only used by the drawing thread. */
+	TestshapeTaskRunner *runner;
+	const TestshapeFillFuncs *fill_funcs;
+	/* Defaults of the fields shape lists do not give. */
+	TestshapeConfig defaults;
+	/* Glyph and sprite caches shared by the streams, cache_lock guards them
+	 * and the rasterization of plans with text or sprites.
+	 */
+	GMutex cache_lock;
+	TestshapeAtlas *atlas;
+	gboolean atlas_opened;
+	TestshapeSprites *sprites;
+};
+
+GST_ELEMENT_REGISTER_DECLARE (testshapebatch);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_BATCH_H__ */
@@ -0,0 +1,377 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Anti-aliasing coverage accumulator.
+ *
+ * This follows the cell based approach of the FreeType "smooth" rasterizer.
+ * An edge crossing the pixel cell (x, y) adds to the cell its height inside
+ * the cell (cover) and twice the area between itself and the left side of the
+ * cell (area), both in subpixel units. Sweeping a row from left to right, the
+ * sum of the covers of the cells passed so far gives the winding of the
+ * pixels between cells, the cell itself is partially covered by its area.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include "gsttestshapecoverage.h"
+
+/* Subpixel precision: 24.8 fixed point. */
+#define TESTSHAPE_COVERAGE_SHIFT 8
+#define TESTSHAPE_COVERAGE_ONE (1 << TESTSHAPE_COVERAGE_SHIFT)
+
+typedef struct
+{
+    gint x, y;
+    gint cover;
+    gint area;
+} TestshapeCell;
+
+/* Run of pixels waiting to be extended by the next one. */
+typedef struct
+{
+    TestshapeCoverageFunc func;
+    gpointer user_data;
+    gint y, x0, x1;
+    guint8 coverage;
+} TestshapeRun;
+
+struct _TestshapeCoverage
+{
+    GArray *cells;
+    gint clip_x0, clip_y0;
+    gint clip_x1, clip_y1;
+};
+
+TestshapeCoverage *gst_testshape_coverage_new (void)
+{
+    TestshapeCoverage *coverage = g_new0 (TestshapeCoverage, 1);
+
+    coverage->cells = g_array_new (FALSE, FALSE, sizeof (TestshapeCell));
+
+    return coverage;
+}
+
+void gst_testshape_coverage_free (TestshapeCoverage * coverage)
+{
+    g_array_free (coverage->cells, TRUE);
+    g_free (coverage);
+}
+
+void gst_testshape_coverage_reset (TestshapeCoverage * coverage, gint x0, gint y0, gint x1, gint y1)
+{
+    g_array_set_size (coverage->cells, 0);
+    coverage->clip_x0 = x0;
+    coverage->clip_y0 = y0;
+    coverage->clip_x1 = MAX (x1, x0);
+    coverage->clip_y1 = MAX (y1, y0);
+}
+
+/* Adds cover and area to cell (x, y), merging with the previous cell when it is the same. */
+static void addCell(TestshapeCoverage *coverage, gint x, gint y, gint cover, gint area)
+{
+    TestshapeCell cell;
+
+    if (cover == 0 && area == 0)
+        return;
+
+    if (coverage->cells->len > 0) {
+        TestshapeCell *last = &g_array_index (coverage->cells, TestshapeCell, coverage->cells->len - 1);
+
+        if (last->x == x && last->y == y) {
+            last->cover += cover;
+            last->area += area;
+            return;
+        }
+    }
+
+    cell.x = x;
+    cell.y = y;
+    cell.cover = cover;
+    cell.area = area;
+    g_array_append_val (coverage->cells, cell);
+}
+
+/* Renders the part of an edge inside row y, from (x0, fy0) to (x1, fy1), x
+ * being in subpixels and fy in subpixels from the top of the row. The edge
+ * is split where it crosses the sides of the cells.
+ */
+static void renderScanline(TestshapeCoverage *coverage, gint y, gint x0, gint fy0, gint x1, gint fy1)
+{
+    gint ex0 = x0 >> TESTSHAPE_COVERAGE_SHIFT;
+    gint ex1 = x1 >> TESTSHAPE_COVERAGE_SHIFT;
+    gint x = x0, fy = fy0, ex = ex0, bx, ny;
+
+    if (fy0 == fy1)
+        return;
+
+    if (ex0 == ex1) {
+        gint base = ex0 << TESTSHAPE_COVERAGE_SHIFT;
+
+        addCell (coverage, ex0, y, fy1 - fy0, (fy1 - fy0) * ((x0 - base) + (x1 - base)));
+        return;
+    }
+
+    if (x1 > x0) {
+        while (ex < ex1) {
+            bx = (ex + 1) << TESTSHAPE_COVERAGE_SHIFT;
+            ny = fy0 + (gint) ((gint64) (fy1 - fy0) * (bx - x0) / (x1 - x0));
+            addCell (coverage, ex, y, ny - fy, (ny - fy) * ((x - (ex << TESTSHAPE_COVERAGE_SHIFT)) + TESTSHAPE_COVERAGE_ONE));
+            x = bx;
+            fy = ny;
+            ex++;
+        }
+    } else {
+        while (ex > ex1) {
+            bx = ex << TESTSHAPE_COVERAGE_SHIFT;
+            ny = fy0 + (gint) ((gint64) (fy1 - fy0) * (x0 - bx) / (x0 - x1));
+            addCell (coverage, ex, y, ny - fy, (ny - fy) * (x - bx));
+            x = bx;
+            fy = ny;
+            ex--;
+        }
+    }
+
+    addCell (coverage, ex1, y, fy1 - fy, (fy1 - fy) * ((x - (ex1 << TESTSHAPE_COVERAGE_SHIFT)) + (x1 - (ex1 << TESTSHAPE_COVERAGE_SHIFT))));
+}
+
+/* Renders an edge in subpixels, split where it crosses the rows. */
+static void renderLine(TestshapeCoverage *coverage, gint x0, gint y0, gint x1, gint y1)
+{
+    gint ey0 = y0 >> TESTSHAPE_COVERAGE_SHIFT;
+    gint ey1 = y1 >> TESTSHAPE_COVERAGE_SHIFT;
+    gint x = x0, ey = ey0, by, nx;
+    gint fy = y0 - (ey0 << TESTSHAPE_COVERAGE_SHIFT);
+
+    if (y0 == y1)
+        return;
+
+    if (y1 > y0) {
+        while (ey < ey1) {
+            by = (ey + 1) << TESTSHAPE_COVERAGE_SHIFT;
+            nx = x0 + (gint) ((gint64) (x1 - x0) * (by - y0) / (y1 - y0));
+            renderScanline (coverage, ey, x, fy, nx, TESTSHAPE_COVERAGE_ONE);
+            x = nx;
+            fy = 0;
+            ey++;
+        }
+    } else {
+        while (ey > ey1) {
+            by = ey << TESTSHAPE_COVERAGE_SHIFT;
+            nx = x0 + (gint) ((gint64) (x1 - x0) * (y0 - by) / (y0 - y1));
+            renderScanline (coverage, ey, x, fy, nx, 0);
+            x = nx;
+            fy = TESTSHAPE_COVERAGE_ONE;
+            ey--;
+        }
+    }
+
+    renderScanline (coverage, ey1, x, fy, x1, y1 - (ey1 << TESTSHAPE_COVERAGE_SHIFT));
+}
+
+/* Converts a position in pixels to subpixels. */
+static gint toSubpixel(gdouble value)
+{
+    return (gint) lrint (value * TESTSHAPE_COVERAGE_ONE);
+}
+
+/* Clips an edge in pixels against the clip rectangle and renders it.
+ * Parts above or below the clip rows are dropped. Parts left of it are moved
+ * onto its left side, where they still count for the winding of the pixels
+ * on their right, parts right of it cannot cover anything and are dropped.
+ */
+static void addEdge(TestshapeCoverage *coverage, gdouble x0, gdouble y0, gdouble x1, gdouble y1)
+{
+    gdouble top = coverage->clip_y0, bottom = coverage->clip_y1;
+    gdouble left = coverage->clip_x0, right = coverage->clip_x1;
+    gdouble t[4], ox0 = x0, oy0 = y0;
+    guint n = 0, i;
+
+    if (y0 == y1 || (y0 <= top && y1 <= top) || (y0 >= bottom && y1 >= bottom))
+        return;
+
+    if (y0 < top || y0 > bottom) {
+        gdouble ty = y0 < top ? top : bottom;
+
+        x0 = ox0 + (x1 - ox0) * (ty - oy0) / (y1 - oy0);
+        y0 = ty;
+    }
+    if (y1 < top || y1 > bottom) {
+        gdouble ty = y1 < top ? top : bottom;
+
+        x1 = ox0 + (x1 - ox0) * (ty - oy0) / (y1 - oy0);
+        y1 = ty;
+    }
+
+    /* Split where the edge crosses the left and right sides. */
+    t[n++] = 0.0;
+    if ((x0 - left) * (x1 - left) < 0)
+        t[n++] = (left - x0) / (x1 - x0);
+    if ((x0 - right) * (x1 - right) < 0)
+        t[n++] = (right - x0) / (x1 - x0);
+    if (n == 3 && t[2] < t[1]) {
+        gdouble tmp = t[1];
+
+        t[1] = t[2];
+        t[2] = tmp;
+    }
+    t[n++] = 1.0;
+
+    for (i = 0; i + 1 < n; i++) {
+        gdouble xa = x0 + (x1 - x0) * t[i], ya = y0 + (y1 - y0) * t[i];
+        gdouble xb = x0 + (x1 - x0) * t[i + 1], yb = y0 + (y1 - y0) * t[i + 1];
+        gdouble mid = (xa + xb) / 2;
+
+        if (mid >= right)
+            continue;
+        if (mid <= left)
+            xa = xb = left;
+
+        renderLine (coverage, toSubpixel (xa), toSubpixel (ya), toSubpixel (xb), toSubpixel (yb));
+    }
+}
+
+void gst_testshape_coverage_add_polygon (TestshapeCoverage * coverage, const gdouble * points, guint n_points,
+    gdouble scale_x, gdouble scale_y)
+{
+    guint i;
+
+    if (n_points < 3)
+        return;
+
+    for (i = 0; i < n_points; i++) {
+        guint j = i + 1 < n_points ? i + 1 : 0;
+
+        addEdge (coverage, points[2 * i] * scale_x, points[2 * i + 1] * scale_y,
+            points[2 * j] * scale_x, points[2 * j + 1] * scale_y);
+    }
+}
+
+/* Orders cells by row, then by column. */
+static gint compareCells(gconstpointer a, gconstpointer b)
+{
+    const TestshapeCell *ca = a, *cb = b;
+
+    if (ca->y != cb->y)
+        return ca->y < cb->y ? -1 : 1;
+    return ca->x < cb->x ? -1 : ca->x > cb->x;
+}
+
+/* Maps twice the covered area, in squared subpixels, onto a coverage. */
+static guint8 areaToCoverage(gint64 area, TestshapeFillRule rule)
+{
+    gint64 value = ABS (area) >> (2 * TESTSHAPE_COVERAGE_SHIFT + 1 - 8);
+
+    if (rule == TESTSHAPE_FILL_EVENODD) {
+        value &= 511;
+        if (value > 256)
+            value = 512 - value;
+    }
+
+    return (guint8) MIN (value, 255);
+}
+
+/* Emits a run, merged with the pending one when it continues it. */
+static void emitRun(TestshapeRun *run, gint y, gint x0, gint x1, guint8 coverage)
+{
+    if (coverage == 0 || x0 >= x1)
+        return;
+
+    if (run->coverage == coverage && run->y == y && run->x1 == x0) {
+        run->x1 = x1;
+        return;
+    }
+
+    if (run->coverage != 0)
+        run->func (run->user_data, run->y, run->x0, run->x1, run->coverage);
+
+    run->y = y;
+    run->x0 = x0;
+    run->x1 = x1;
+    run->coverage = coverage;
+}
+
+void gst_testshape_coverage_sweep (TestshapeCoverage * coverage, TestshapeFillRule rule, TestshapeCoverageFunc func,
+    gpointer user_data)
+{
+    GArray *cells = coverage->cells;
+    TestshapeRun run = { func, user_data, 0, 0, 0, 0 };
+    guint i = 0;
+
+    g_array_sort (cells, compareCells);
+
+    while (i < cells->len) {
+        gint y = g_array_index (cells, TestshapeCell, i).y;
+        gint x = coverage->clip_x0;
+        gint64 cover = 0;
+
+        while (i < cells->len && g_array_index (cells, TestshapeCell, i).y == y) {
+            gint cx = g_array_index (cells, TestshapeCell, i).x;
+            gint64 area = 0;
+
+            /* Cells of the same pixel from several edges are merged here. */
+            if (cover != 0 && cx > x)
+                emitRun (&run, y, x, MIN (cx, coverage->clip_x1), areaToCoverage (cover * 2 * TESTSHAPE_COVERAGE_ONE, rule));
+            for (; i < cells->len && g_array_index (cells, TestshapeCell, i).y == y &&
+                g_array_index (cells, TestshapeCell, i).x == cx; i++) {
+                cover += g_array_index (cells, TestshapeCell, i).cover;
+                area += g_array_index (cells, TestshapeCell, i).area;
+            }
+
+            if (cx >= coverage->clip_x0 && cx < coverage->clip_x1)
+                emitRun (&run, y, cx, cx + 1, areaToCoverage (cover * 2 * TESTSHAPE_COVERAGE_ONE - area, rule));
+            x = cx + 1;
+        }
+
+        /* Edges right of the clip rectangle were dropped, the winding left at
+         * the end of the row covers the rest of it.
+         */
+        if (cover != 0 && x < coverage->clip_x1)
+            emitRun (&run, y, x, coverage->clip_x1, areaToCoverage (cover * 2 * TESTSHAPE_COVERAGE_ONE, rule));
+    }
+
+    if (run.coverage != 0)
+        func (user_data, run.y, run.x0, run.x1, run.coverage);
+}
@@ -0,0 +1,89 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_COVERAGE_H__
+#define __GST_TESTSHAPE_COVERAGE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Rules deciding which parts of overlapping or nested paths are inside. */
+typedef enum
+{
+	TESTSHAPE_FILL_NONZERO,
+	TESTSHAPE_FILL_EVENODD,
+} TestshapeFillRule;
+
+/* Scanline coverage accumulator for anti-aliased drawing.
+ * Closed polygons are added edge by edge in 24.8 fixed point. Every edge only
+ * visits the pixel cells it crosses, storing the exact area it covers, and
+ * the sweep turns the cells into runs of constant coverage, so the cost is
+ * proportional to the edge length and not to the area of the shape.
+ */
+typedef struct _TestshapeCoverage TestshapeCoverage;
+
+/* Receives a run of pixels [x0, x1) on row y with coverage from 1 to 255. */
+typedef void (*TestshapeCoverageFunc) (gpointer user_data, gint y, gint x0, gint x1, guint8 coverage);
+
+TestshapeCoverage *gst_testshape_coverage_new (void);
+
+void gst_testshape_coverage_free (TestshapeCoverage * coverage);
+
+/* Drops the accumulated edges and restricts the coverage to the pixels of [x0, x1) x [y0, y1). */
+void gst_testshape_coverage_reset (TestshapeCoverage * coverage, gint x0, gint y0, gint x1, gint y1);
+
+/* Adds a closed polygon of n_points (x, y) pairs in pixel units, pixel (x, y)
+ * being the square [x, x + 1) x [y, y + 1). The points are multiplied by
+ * scale_x and scale_y first, which maps them onto subsampled planes.
+ */
+void gst_testshape_coverage_add_polygon (TestshapeCoverage * coverage, const gdouble * points, guint n_points,
+    gdouble scale_x, gdouble scale_y);
+
+/* Calls func for the covered runs of pixels in row order, left to right. */
+void gst_testshape_coverage_sweep (TestshapeCoverage * coverage, TestshapeFillRule rule, TestshapeCoverageFunc func,
+    gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_COVERAGE_H__ */
@@ -0,0 +1,2020 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Drawing core of testshape.
+ *
+ * Shapes are rasterized into spans, horizontal runs of pixels clipped to
+ * the image, which are sorted by row into a draw plan. Drawing a plan writes
+ * only the spans, through the plane writer of the image format. Nothing here
+ * depends on a pipeline, the element and the tools share this code.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "gsttestshapedraw.h"
+
+/* State of the rasterizer while the spans of one shape are generated. */
+typedef struct
+{
+    GArray *spans;
+    GArray *chroma_spans;
+    GArray *chroma_row;
+    GArray *chroma_sums;
+    gboolean chroma_coverage;
+    const TestshapeWriter *writer;
+    guint shape;
+    gint clip_x0, clip_y0;
+    gint clip_x1, clip_y1;
+    TestshapeCoverage *coverage;
+    GArray *path;
+    gboolean antialias;
+    const TestshapePoint *points;
+    GArray *edges;
+    GArray *active;
+    TestshapeAtlas *atlas;
+    gint font_size;
+    const gchar *text;
+    GArray *mask;
+} TestshapeRaster;
+
+/* Edge of a polygon in the scanline filler, going from (x0, y0) down or up
+ * with winding 1 or -1. It crosses the pixel centers of rows [row0, row1),
+ * x is where it crosses the current row.
+ */
+typedef struct
+{
+    gdouble x0, y0;
+    gdouble dxdy;
+    gdouble x;
+    gint row0, row1;
+    gint winding;
+} TestshapeEdge;
+
+/* What the last rasterization made of a shape: the shape, the bytes of its
+ * points, text or file at data_offset in the cache data, its spans from first
+ * and chroma_first in the unsorted spans, the rows [y0, y1) of its luma and
+ * chroma spans and the pixels of its luma spans.
+ */
+typedef struct
+{
+    TestshapeShape shape;
+    guint data_offset, data_length;
+    guint first, n_spans;
+    guint chroma_first, n_chroma_spans;
+    gint y0, y1;
+    guint64 pixels;
+} TestshapeShapeCache;
+
+/* Rows of a bin of the spatial index of the spans. Even, so that a chroma row
+ * never straddles two bins.
+ */
+#define TESTSHAPE_BIN_ROWS 32
+
+/* Largest distance between a circle and the polygon approximating it, in pixels. */
+#define TESTSHAPE_CIRCLE_TOLERANCE (1.0 / 16)
+
+/* Longest miter joint, relative to the stroke width, as in SVG. Sharper
+ * joints are beveled.
+ */
+#define TESTSHAPE_MITER_LIMIT 4.0
+
+/* Allocates the arrays of an empty draw plan. */
+void gst_testshape_plan_init (TestshapePlan * plan)
+{
+    plan->pixels = 0;
+    plan->shapes = g_array_new(FALSE, FALSE, sizeof(TestshapeShape));
+    plan->points = g_array_new(FALSE, FALSE, sizeof(TestshapePoint));
+    plan->text = g_array_new(FALSE, FALSE, sizeof(gchar));
+    plan->spans = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->scratch = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->rows = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->chroma_spans = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->chroma_scratch = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->chroma_rows = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->chroma_row = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->chroma_sums = g_array_new(FALSE, TRUE, sizeof(guint32));
+    plan->chroma_coverage = FALSE;
+    plan->writer = gst_testshape_writer_get (GST_VIDEO_FORMAT_NV12);
+    plan->has_clip = FALSE;
+    plan->coverage = gst_testshape_coverage_new ();
+    plan->path = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    plan->edges = g_array_new(FALSE, FALSE, sizeof(TestshapeEdge));
+    plan->active = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->atlas = NULL;
+    plan->font_size = 16;
+    plan->mask = g_array_new(FALSE, FALSE, sizeof(guint8));
+    plan->sprites = NULL;
+    plan->files = g_array_new(FALSE, FALSE, sizeof(gchar));
+    plan->stamps = g_array_new(FALSE, TRUE, sizeof(TestshapePlacedStamp));
+    plan->stamp_scratch = g_array_new(FALSE, TRUE, sizeof(TestshapePlacedStamp));
+    plan->cache = g_array_new(FALSE, FALSE, sizeof(TestshapeShapeCache));
+    plan->cache_data = g_array_new(FALSE, FALSE, sizeof(guint8));
+    plan->cache_scratch = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->cache_chroma_scratch = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->next_cache_data = g_array_new(FALSE, FALSE, sizeof(guint8));
+    plan->shape_rows = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->bins = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->bin_shapes = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->dirty_bins = g_array_new(FALSE, FALSE, sizeof(guint8));
+    plan->last_spans = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->last_rows = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->last_chroma_spans = g_array_new(FALSE, FALSE, sizeof(TestshapeSpan));
+    plan->last_chroma_rows = g_array_new(FALSE, FALSE, sizeof(guint));
+    plan->cache_valid = FALSE;
+    plan->cache_width = 0;
+    plan->cache_height = 0;
+}
+
+/* Drops the references of the plan to the stamps of an array. */
+static void releaseStamps(GArray *stamps)
+{
+    guint i;
+
+    for (i = 0; i < stamps->len; i++) {
+        TestshapeStamp *stamp = g_array_index(stamps, TestshapePlacedStamp, i).stamp;
+
+        if (stamp != NULL)
+            gst_testshape_stamp_unref (stamp);
+    }
+    g_array_set_size(stamps, 0);
+}
+
+/* Frees the arrays of a draw plan. */
+void gst_testshape_plan_clear (TestshapePlan * plan)
+{
+    g_array_free(plan->shapes, TRUE);
+    g_array_free(plan->points, TRUE);
+    g_array_free(plan->text, TRUE);
+    g_array_free(plan->spans, TRUE);
+    g_array_free(plan->scratch, TRUE);
+    g_array_free(plan->rows, TRUE);
+    g_array_free(plan->chroma_spans, TRUE);
+    g_array_free(plan->chroma_scratch, TRUE);
+    g_array_free(plan->chroma_rows, TRUE);
+    g_array_free(plan->chroma_row, TRUE);
+    g_array_free(plan->chroma_sums, TRUE);
+    gst_testshape_coverage_free (plan->coverage);
+    g_array_free(plan->path, TRUE);
+    g_array_free(plan->edges, TRUE);
+    g_array_free(plan->active, TRUE);
+    g_array_free(plan->mask, TRUE);
+    g_array_free(plan->files, TRUE);
+    releaseStamps(plan->stamps);
+    g_array_free(plan->stamps, TRUE);
+    g_array_free(plan->stamp_scratch, TRUE);
+    g_array_free(plan->cache, TRUE);
+    g_array_free(plan->cache_data, TRUE);
+    g_array_free(plan->cache_scratch, TRUE);
+    g_array_free(plan->cache_chroma_scratch, TRUE);
+    g_array_free(plan->next_cache_data, TRUE);
+    g_array_free(plan->shape_rows, TRUE);
+    g_array_free(plan->bins, TRUE);
+    g_array_free(plan->bin_shapes, TRUE);
+    g_array_free(plan->dirty_bins, TRUE);
+    g_array_free(plan->last_spans, TRUE);
+    g_array_free(plan->last_rows, TRUE);
+    g_array_free(plan->last_chroma_spans, TRUE);
+    g_array_free(plan->last_chroma_rows, TRUE);
+}
+
+gboolean gst_testshape_plan_set_format (TestshapePlan * plan, GstVideoFormat format)
+{
+    const TestshapeWriter *writer = gst_testshape_writer_get (format);
+
+    if (writer == NULL)
+        return FALSE;
+
+    if (writer != plan->writer)
+        plan->cache_valid = FALSE;
+    plan->writer = writer;
+    return TRUE;
+}
+
+void gst_testshape_plan_set_clip (TestshapePlan * plan, const TestshapeRect * clip)
+{
+    if ((clip != NULL) != plan->has_clip || (clip != NULL && (clip->x != plan->clip.x || clip->y != plan->clip.y ||
+            clip->width != plan->clip.width || clip->height != plan->clip.height)))
+        plan->cache_valid = FALSE;
+
+    plan->has_clip = clip != NULL;
+    if (clip != NULL)
+        plan->clip = *clip;
+}
+
+void gst_testshape_plan_set_font (TestshapePlan * plan, TestshapeAtlas * atlas, gint size)
+{
+    if (atlas != plan->atlas || size != plan->font_size)
+        plan->cache_valid = FALSE;
+    plan->atlas = atlas;
+    plan->font_size = size;
+}
+
+void gst_testshape_plan_set_sprites (TestshapePlan * plan, TestshapeSprites * sprites)
+{
+    if (sprites != plan->sprites)
+        plan->cache_valid = FALSE;
+    plan->sprites = sprites;
+}
+
+void gst_testshape_plan_set_chroma_coverage (TestshapePlan * plan, gboolean chroma_coverage)
+{
+    if (chroma_coverage != plan->chroma_coverage)
+        plan->cache_valid = FALSE;
+    plan->chroma_coverage = chroma_coverage;
+}
+
+/* Appends a span of the current shape to the list after clipping it against the clip rectangle.
+ * Coordinates are 64 bit so that shapes anywhere in the 32 bit range cannot overflow.
+ */
+static void addSpan(TestshapeRaster *raster, gint64 y, gint64 x0, gint64 x1)
+{
+    TestshapeSpan span;
+
+    if (y < raster->clip_y0 || y >= raster->clip_y1)
+        return;
+
+    x0 = MAX(x0, raster->clip_x0);
+    x1 = MIN(x1, raster->clip_x1);
+    if (x0 >= x1)
+        return;
+
+    span.y = (gint) y;
+    span.x0 = (gint) x0;
+    span.x1 = (gint) x1;
+    span.shape = raster->shape;
+    span.coverage = 255;
+    g_array_append_val(raster->spans, span);
+}
+
+/* Function to draw RECTANGLE shape.
+ * Emits the spans of an axis aligned box [rect_x1, rect_x2) x [rect_y1, rect_y2):
+ * full rows for the top and bottom edges, two short runs per row for the sides.
+ * Only the rows inside the clip rectangle are visited.
+ */
+static void drawRectangle(TestshapeRaster *raster, gint64 rect_x1, gint64 rect_y1, gint64 rect_x2, gint64 rect_y2, gint thickness, gboolean fill){
+    gint64 y1, y_end;
+
+    y_end = MIN(rect_y2, raster->clip_y1);
+    for (y1 = MAX(rect_y1, raster->clip_y0); y1 < y_end; y1++) {
+        if (fill || y1 < rect_y1 + thickness || y1 >= rect_y2 - thickness ||
+            rect_x2 - rect_x1 <= 2 * (gint64) thickness) {
+            addSpan(raster, y1, rect_x1, rect_x2);
+        } else {
+            addSpan(raster, y1, rect_x1, rect_x1 + thickness);
+            addSpan(raster, y1, rect_x2 - thickness, rect_x2);
+        }
+    }
+}
+
+/* Function to draw SQUARE shape. */
+static void drawSquare(TestshapeRaster *raster, gint64 square_x1, gint64 square_y1, gint64 square_x2, gint64 square_y2, gint thickness, gboolean fill) {
+    drawRectangle(raster, square_x1, square_y1, square_x2, square_y2, thickness, fill);
+}
+
+/* Function to draw CIRCLE shape.
+ * For every row the outer and inner half widths of the ring are solved from
+ * (radius - thickness)^2 <= dx^2 + dy^2 <= radius^2 instead of testing pixels.
+ * Only the rows inside the clip rectangle are visited.
+ */
+static void drawCircle(TestshapeRaster *raster, gint64 circle_x, gint64 circle_y, gint radius, gint thickness, gboolean fill){
+    gint64 outer_sq, inner_sq, dy_sq;
+    gint64 dy, dy_end, outer, inner, inner_radius;
+
+    if (radius <= 0)
+        return;
+
+    inner_radius = (gint64) radius - thickness;
+    outer_sq = (gint64) radius * radius;
+    inner_sq = inner_radius * inner_radius;
+
+    dy_end = MIN((gint64) radius, raster->clip_y1 - 1 - circle_y);
+    for (dy = MAX(-(gint64) radius, raster->clip_y0 - circle_y); dy <= dy_end; dy++) {
+        dy_sq = dy * dy;
+        outer = (gint64) sqrt((gdouble) (outer_sq - dy_sq));
+        while ((outer + 1) * (outer + 1) + dy_sq <= outer_sq)
+            outer++;
+        while (outer > 0 && outer * outer + dy_sq > outer_sq)
+            outer--;
+
+        /* Rows that lie entirely inside the ring are drawn as a single run. */
+        if (fill || inner_radius <= 0 || dy_sq >= inner_sq) {
+            addSpan(raster, circle_y + dy, circle_x - outer, circle_x + outer + 1);
+            continue;
+        }
+
+        inner = (gint64) ceil(sqrt((gdouble) (inner_sq - dy_sq)));
+        while (inner > 0 && (inner - 1) * (inner - 1) + dy_sq >= inner_sq)
+            inner--;
+        while (inner * inner + dy_sq < inner_sq)
+            inner++;
+
+        if (inner > outer)
+            continue;
+
+        addSpan(raster, circle_y + dy, circle_x - outer, circle_x - inner + 1);
+        addSpan(raster, circle_y + dy, circle_x + inner, circle_x + outer + 1);
+    }
+}
+
+/* Function to draw TRIANGLE shape.
+ * The apex is (triangle_x1, triangle_y1) and the base runs from triangle_x2
+ * to triangle_x3 on row triangle_y2. Each row gets one run per slanted edge,
+ * merged into a single run where they meet, plus full runs for the base.
+ * Only the rows inside the clip rectangle are visited.
+ */
+static void drawTriangle(TestshapeRaster *raster, gint64 triangle_x1, gint64 triangle_y1, gint64 triangle_x2, gint64 triangle_y2, gint64 triangle_x3, gint thickness, gboolean fill){
+    gint64 y1, y_end, left, right, rows;
+
+    rows = triangle_y2 - triangle_y1;
+    if (rows < 0)
+        return;
+
+    y_end = MIN(triangle_y2, raster->clip_y1 - 1);
+    for (y1 = MAX(triangle_y1, raster->clip_y0); y1 <= y_end; y1++) {
+        if (rows == 0) {
+            left = triangle_x2;
+            right = triangle_x3;
+        } else {
+            left = triangle_x1 + (triangle_x2 - triangle_x1) * (y1 - triangle_y1) / rows;
+            right = triangle_x1 + (triangle_x3 - triangle_x1) * (y1 - triangle_y1) / rows;
+        }
+
+        if (fill || y1 > triangle_y2 - thickness || right - left + 1 <= 2 * (gint64) thickness) {
+            addSpan(raster, y1, left, right + 1);
+        } else {
+            addSpan(raster, y1, left, left + thickness);
+            addSpan(raster, y1, right - thickness + 1, right + 1);
+        }
+    }
+}
+
+/* Gets the bounding box [x1, x2) x [y1, y2) of a shape, FALSE if it has none. */
+static gboolean getBounds(TestshapeRaster *raster, const TestshapeShape *shape, gint64 *bounds)
+{
+    gint64 x1, y1, x2, y2, margin;
+    guint i;
+
+    switch (shape->type) {
+        case TESTSHAPE_SHAPE_RECTANGLE:
+            x1 = (gint64) shape->x - (shape->width / 2);
+            y1 = (gint64) shape->y - (shape->height / 2);
+            x2 = x1 + shape->width;
+            y2 = y1 + shape->height;
+            break;
+        case TESTSHAPE_SHAPE_SPRITE:
+            x1 = shape->x;
+            y1 = shape->y;
+            x2 = x1 + shape->width;
+            y2 = y1 + shape->height;
+            break;
+        case TESTSHAPE_SHAPE_SQUARE:
+            x1 = (gint64) shape->x - (shape->width / 2);
+            y1 = (gint64) shape->y - (shape->width / 2);
+            x2 = x1 + shape->width;
+            y2 = y1 + shape->width;
+            break;
+        case TESTSHAPE_SHAPE_CIRCLE:
+            x1 = (gint64) shape->x - shape->width;
+            y1 = (gint64) shape->y - shape->width;
+            x2 = (gint64) shape->x + shape->width + 1;
+            y2 = (gint64) shape->y + shape->width + 1;
+            break;
+        case TESTSHAPE_SHAPE_TRIANGLE:
+            x1 = (gint64) shape->x - shape->width;
+            y1 = (gint64) shape->y - (shape->width / 2);
+            x2 = (gint64) shape->x + shape->width + 1;
+            y2 = y1 + shape->width + 1;
+            break;
+        case TESTSHAPE_SHAPE_POLYGON:
+        case TESTSHAPE_SHAPE_POLYLINE:
+            if (shape->n_points == 0)
+                return FALSE;
+
+            x1 = y1 = G_MAXINT64;
+            x2 = y2 = G_MININT64;
+            for (i = 0; i < shape->n_points; i++) {
+                const TestshapePoint *point = &raster->points[shape->first_point + i];
+
+                x1 = MIN(x1, point->x);
+                y1 = MIN(y1, point->y);
+                x2 = MAX(x2, point->x);
+                y2 = MAX(y2, point->y);
+            }
+
+            /* Strokes reach out by half the thickness, miters up to the miter limit. */
+            margin = shape->type == TESTSHAPE_SHAPE_POLYGON && shape->fill ? 0 :
+                (gint64) ceil(shape->thickness / 2.0 * TESTSHAPE_MITER_LIMIT);
+            x1 += shape->x - margin;
+            y1 += shape->y - margin;
+            x2 += shape->x + margin + 1;
+            y2 += shape->y + margin + 1;
+            break;
+        default:
+            return FALSE;
+    }
+
+    bounds[0] = x1;
+    bounds[1] = y1;
+    bounds[2] = x2;
+    bounds[3] = y2;
+    return TRUE;
+}
+
+/* Rasterizes one shape, given by its center and size, into spans.
+ * Shapes whose bounding box misses the clip rectangle are skipped right away.
+ */
+static void drawShape(TestshapeRaster *raster, const TestshapeShape *shape)
+{
+    gint64 bounds[4], x1, y1, x2, y2;
+
+    if (!getBounds(raster, shape, bounds))
+        return;
+
+    x1 = bounds[0];
+    y1 = bounds[1];
+    x2 = bounds[2];
+    y2 = bounds[3];
+    if (x2 <= raster->clip_x0 || x1 >= raster->clip_x1 || y2 <= raster->clip_y0 || y1 >= raster->clip_y1)
+        return;
+
+    switch (shape->type) {
+        case TESTSHAPE_SHAPE_RECTANGLE:
+            drawRectangle(raster, x1, y1, x2, y2, shape->thickness, shape->fill);
+            break;
+        case TESTSHAPE_SHAPE_SQUARE:
+            drawSquare(raster, x1, y1, x2, y2, shape->thickness, shape->fill);
+            break;
+        case TESTSHAPE_SHAPE_CIRCLE:
+            drawCircle(raster, shape->x, shape->y, shape->width, shape->thickness, shape->fill);
+            break;
+        case TESTSHAPE_SHAPE_TRIANGLE:
+            drawTriangle(raster, shape->x, y1, (gint64) shape->x - shape->width, y2 - 1, (gint64) shape->x + shape->width, shape->thickness, shape->fill);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Appends a point to the path, scaled onto the plane being rasterized. */
+static void addPoint(GArray *path, gdouble x, gdouble y, gdouble scale_x, gdouble scale_y)
+{
+    gdouble point[2];
+
+    point[0] = x * scale_x;
+    point[1] = y * scale_y;
+    g_array_append_vals(path, point, 2);
+}
+
+/* Adds the edges of a closed polygon to the edge table of the scanline filler.
+ * Row y samples the pixel centers at y + 0.5, edges crossing none of the
+ * rows inside the clip rectangle, horizontal ones included, are dropped.
+ */
+static void addEdges(TestshapeRaster *raster, const gdouble *points, guint n_points)
+{
+    guint i;
+
+    for (i = 0; i < n_points; i++) {
+        const gdouble *a = points + 2 * i;
+        const gdouble *b = points + 2 * ((i + 1) % n_points);
+        TestshapeEdge edge;
+        gint64 row0, row1;
+
+        row0 = MAX((gint64) ceil(MIN(a[1], b[1]) - 0.5), raster->clip_y0);
+        row1 = MIN((gint64) ceil(MAX(a[1], b[1]) - 0.5), raster->clip_y1);
+        if (row0 >= row1)
+            continue;
+
+        edge.x0 = a[0];
+        edge.y0 = a[1];
+        edge.dxdy = (b[0] - a[0]) / (b[1] - a[1]);
+        edge.x = 0;
+        edge.row0 = (gint) row0;
+        edge.row1 = (gint) row1;
+        edge.winding = a[1] < b[1] ? 1 : -1;
+        g_array_append_val(raster->edges, edge);
+    }
+}
+
+/* Orders edges by their first row. */
+static gint compareEdges(gconstpointer a, gconstpointer b)
+{
+    return ((const TestshapeEdge *) a)->row0 - ((const TestshapeEdge *) b)->row0;
+}
+
+/* Tells if a winding number is inside the filled area. */
+static gboolean isInside(gint winding, TestshapeFillRule rule)
+{
+    return rule == TESTSHAPE_FILL_EVENODD ? (winding & 1) != 0 : winding != 0;
+}
+
+/* Fills the edge table with an active edge table scanline sweep. Edges join
+ * the active list at their first row and leave it after their last one, so
+ * every row only looks at the edges crossing it, and rows without any are
+ * skipped. The cost is that of the edges and of the filled pixels, not of the
+ * bounding box. A pixel is inside when its center is, by the fill rule
+ * applied to the winding of the edges left of it.
+ */
+static void fillEdges(TestshapeRaster *raster, TestshapeFillRule rule)
+{
+    GArray *edges = raster->edges;
+    GArray *active = raster->active;
+    guint next = 0, i, j, k;
+    gint y = 0;
+
+    g_array_sort(edges, compareEdges);
+    g_array_set_size(active, 0);
+
+    while (next < edges->len || active->len > 0) {
+        guint *list;
+        gdouble start = 0;
+        gint winding = 0;
+
+        if (active->len == 0)
+            y = g_array_index(edges, TestshapeEdge, next).row0;
+
+        for (; next < edges->len && g_array_index(edges, TestshapeEdge, next).row0 <= y; next++)
+            g_array_append_val(active, next);
+
+        /* Drop the edges that ended and move the others to this row. The list
+         * stays nearly sorted from row to row, an insertion sort keeps it in x order.
+         */
+        list = (guint *) active->data;
+        for (i = 0, j = 0; i < active->len; i++) {
+            guint index = list[i];
+            TestshapeEdge *edge = &g_array_index(edges, TestshapeEdge, index);
+
+            if (edge->row1 <= y)
+                continue;
+
+            edge->x = edge->x0 + (y + 0.5 - edge->y0) * edge->dxdy;
+            for (k = j; k > 0 && g_array_index(edges, TestshapeEdge, list[k - 1]).x > edge->x; k--)
+                list[k] = list[k - 1];
+            list[k] = index;
+            j++;
+        }
+        g_array_set_size(active, j);
+
+        for (i = 0; i < j; i++) {
+            const TestshapeEdge *edge = &g_array_index(edges, TestshapeEdge, list[i]);
+            gboolean was_inside = isInside(winding, rule);
+
+            winding += edge->winding;
+            if (!was_inside && isInside(winding, rule))
+                start = edge->x;
+            else if (was_inside && !isInside(winding, rule))
+                addSpan(raster, y, (gint64) ceil(start - 0.5), (gint64) ceil(edge->x - 0.5));
+        }
+
+        y++;
+    }
+}
+
+/* Adds the polygon held by the path to the coverage accumulator of
+ * anti-aliased shapes or to the edge table, and empties the path.
+ */
+static void flushPath(TestshapeRaster *raster)
+{
+    if (raster->antialias)
+        gst_testshape_coverage_add_polygon (raster->coverage, (const gdouble *) raster->path->data,
+            raster->path->len / 2, 1.0, 1.0);
+    else
+        addEdges(raster, (const gdouble *) raster->path->data, raster->path->len / 2);
+    g_array_set_size(raster->path, 0);
+}
+
+/* Adds a circle as a polygon whose sides stay within TESTSHAPE_CIRCLE_TOLERANCE
+ * of it, so large circles get more sides and small ones stay cheap.
+ */
+static void addCirclePath(TestshapeRaster *raster, gdouble cx, gdouble cy, gdouble radius, gdouble scale_x, gdouble scale_y)
+{
+    gdouble step;
+    guint n, i;
+
+    if (radius <= TESTSHAPE_CIRCLE_TOLERANCE)
+        return;
+
+    step = 2 * acos(1.0 - TESTSHAPE_CIRCLE_TOLERANCE / radius);
+    n = (guint) CLAMP(ceil(2 * G_PI / step), 8, 4096);
+    for (i = 0; i < n; i++)
+        addPoint(raster->path, cx + radius * cos(2 * G_PI * i / n), cy + radius * sin(2 * G_PI * i / n), scale_x, scale_y);
+    flushPath(raster);
+}
+
+/* Adds a convex polygon of up to four points wound counterclockwise on
+ * screen, reversing it if needed, so that overlapping pieces of a stroke
+ * add up under the non-zero rule instead of cancelling out.
+ */
+static void addWoundPath(TestshapeRaster *raster, const gdouble *points, guint n_points, gdouble scale_x, gdouble scale_y)
+{
+    gdouble area = 0;
+    guint i;
+
+    for (i = 0; i < n_points; i++) {
+        const gdouble *a = points + 2 * i;
+        const gdouble *b = points + 2 * ((i + 1) % n_points);
+        area += a[0] * b[1] - b[0] * a[1];
+    }
+    if (area == 0)
+        return;
+
+    for (i = 0; i < n_points; i++) {
+        guint j = area > 0 ? i : n_points - 1 - i;
+        addPoint(raster->path, points[2 * j], points[2 * j + 1], scale_x, scale_y);
+    }
+    flushPath(raster);
+}
+
+/* Returns vertex i of a polygon or polyline, on the center of its pixel. */
+static void getVertex(TestshapeRaster *raster, const TestshapeShape *shape, guint i, gdouble *x, gdouble *y)
+{
+    const TestshapePoint *point = &raster->points[shape->first_point + i];
+
+    *x = (gdouble) shape->x + point->x + 0.5;
+    *y = (gdouble) shape->y + point->y + 0.5;
+}
+
+/* Adds the joint at (x, y) between two segments of a stroke given by their
+ * normals, scaled to half the stroke width. It fills the wedge left open on
+ * the outer side of the turn, up to the miter point or beveled.
+ */
+static void addJoint(TestshapeRaster *raster, gdouble x, gdouble y, gdouble nx0, gdouble ny0, gdouble nx1, gdouble ny1,
+    gdouble scale_x, gdouble scale_y)
+{
+    gdouble half_sq = nx0 * nx0 + ny0 * ny0;
+    gdouble dot = nx0 * nx1 + ny0 * ny1;
+    gdouble cross = nx0 * ny1 - ny0 * nx1;
+    gdouble side = cross > 0 ? -1.0 : 1.0;
+    gdouble piece[8];
+    guint n = 0;
+
+    /* Straight on, nothing is left open. */
+    if (cross == 0 && dot > 0)
+        return;
+
+    piece[n++] = x;
+    piece[n++] = y;
+    piece[n++] = x + side * nx0;
+    piece[n++] = y + side * ny0;
+    /* The miter point is where the outer sides of both segments meet. */
+    if (half_sq + dot >= 2 * half_sq / (TESTSHAPE_MITER_LIMIT * TESTSHAPE_MITER_LIMIT)) {
+        piece[n++] = x + side * (nx0 + nx1) * half_sq / (half_sq + dot);
+        piece[n++] = y + side * (ny0 + ny1) * half_sq / (half_sq + dot);
+    }
+    piece[n++] = x + side * nx1;
+    piece[n++] = y + side * ny1;
+    addWoundPath(raster, piece, n / 2, scale_x, scale_y);
+}
+
+/* Adds the stroke of a polyline, closed for polygon outlines, thickness pixels
+ * wide: a quad around every segment and a joint between them, filled with the
+ * non-zero rule. Repeated points are skipped, the ends are cut square.
+ */
+static void addStrokePath(TestshapeRaster *raster, const TestshapeShape *shape, gboolean closed, gdouble scale_x, gdouble scale_y)
+{
+    gdouble half = shape->thickness / 2.0;
+    gdouble first_nx = 0, first_ny = 0, prev_nx = 0, prev_ny = 0;
+    gdouble ax, ay, bx, by, piece[8];
+    guint n_segments, i, drawn = 0;
+
+    if (shape->n_points < 2)
+        return;
+
+    n_segments = closed ? shape->n_points : shape->n_points - 1;
+    for (i = 0; i < n_segments; i++) {
+        gdouble nx, ny, length;
+
+        getVertex(raster, shape, i, &ax, &ay);
+        getVertex(raster, shape, (i + 1) % shape->n_points, &bx, &by);
+        length = hypot(bx - ax, by - ay);
+        if (length == 0)
+            continue;
+
+        nx = -(by - ay) / length * half;
+        ny = (bx - ax) / length * half;
+
+        piece[0] = ax + nx;
+        piece[1] = ay + ny;
+        piece[2] = bx + nx;
+        piece[3] = by + ny;
+        piece[4] = bx - nx;
+        piece[5] = by - ny;
+        piece[6] = ax - nx;
+        piece[7] = ay - ny;
+        addWoundPath(raster, piece, 4, scale_x, scale_y);
+
+        if (drawn > 0) {
+            addJoint(raster, ax, ay, prev_nx, prev_ny, nx, ny, scale_x, scale_y);
+        } else {
+            first_nx = nx;
+            first_ny = ny;
+        }
+
+        prev_nx = nx;
+        prev_ny = ny;
+        drawn++;
+    }
+
+    /* Joint between the last and the first segment of a closed outline. */
+    if (closed && drawn > 1) {
+        getVertex(raster, shape, 0, &ax, &ay);
+        addJoint(raster, ax, ay, prev_nx, prev_ny, first_nx, first_ny, scale_x, scale_y);
+    }
+}
+
+/* Adds the area of a shape to the path consumer, in pixel edge coordinates
+ * where pixel (x, y) is the square [x, x + 1) x [y, y + 1), and returns the
+ * fill rule of the area. The outline follows the footprint of the aliased
+ * shape. Shapes that are not filled add an inner outline as well, the
+ * even-odd rule leaves it empty. Polygon vertices sit on pixel centers.
+ */
+static TestshapeFillRule addShapePath(TestshapeRaster *raster, const TestshapeShape *shape, gdouble scale_x, gdouble scale_y)
+{
+    gdouble x1, y1, x2, y2, t = shape->thickness;
+
+    g_array_set_size(raster->path, 0);
+
+    switch (shape->type) {
+        case TESTSHAPE_SHAPE_RECTANGLE:
+        case TESTSHAPE_SHAPE_SQUARE:
+            x2 = shape->width;
+            y2 = shape->type == TESTSHAPE_SHAPE_SQUARE ? shape->width : shape->height;
+            if (x2 <= 0 || y2 <= 0)
+                break;
+
+            x1 = (gdouble) shape->x - (shape->width / 2);
+            y1 = (gdouble) shape->y - ((gint) y2 / 2);
+            x2 += x1;
+            y2 += y1;
+
+            addPoint(raster->path, x1, y1, scale_x, scale_y);
+            addPoint(raster->path, x2, y1, scale_x, scale_y);
+            addPoint(raster->path, x2, y2, scale_x, scale_y);
+            addPoint(raster->path, x1, y2, scale_x, scale_y);
+            flushPath(raster);
+
+            if (!shape->fill && x2 - x1 > 2 * t && y2 - y1 > 2 * t) {
+                addPoint(raster->path, x1 + t, y1 + t, scale_x, scale_y);
+                addPoint(raster->path, x2 - t, y1 + t, scale_x, scale_y);
+                addPoint(raster->path, x2 - t, y2 - t, scale_x, scale_y);
+                addPoint(raster->path, x1 + t, y2 - t, scale_x, scale_y);
+                flushPath(raster);
+            }
+            break;
+        case TESTSHAPE_SHAPE_CIRCLE:
+            if (shape->width <= 0)
+                break;
+
+            /* The aliased circle holds the pixels whose center is within the radius. */
+            addCirclePath(raster, shape->x + 0.5, shape->y + 0.5, shape->width + 0.5, scale_x, scale_y);
+            if (!shape->fill)
+                addCirclePath(raster, shape->x + 0.5, shape->y + 0.5, shape->width + 0.5 - t, scale_x, scale_y);
+            break;
+        case TESTSHAPE_SHAPE_TRIANGLE: {
+            gdouble px[3], py[3], a, b, c, ix, iy, r;
+            guint i;
+
+            if (shape->width < 0)
+                break;
+
+            px[0] = shape->x + 0.5;
+            py[0] = (gdouble) shape->y - (shape->width / 2);
+            px[1] = (gdouble) shape->x - shape->width;
+            py[1] = py[0] + shape->width + 1;
+            px[2] = (gdouble) shape->x + shape->width + 1;
+            py[2] = py[1];
+
+            for (i = 0; i < 3; i++)
+                addPoint(raster->path, px[i], py[i], scale_x, scale_y);
+            flushPath(raster);
+
+            if (shape->fill)
+                break;
+
+            /* The inner outline is the triangle shrunk towards its incenter,
+             * which moves every side inwards by the thickness.
+             */
+            a = hypot(px[2] - px[1], py[2] - py[1]);
+            b = hypot(px[0] - px[2], py[0] - py[2]);
+            c = hypot(px[1] - px[0], py[1] - py[0]);
+            ix = (a * px[0] + b * px[1] + c * px[2]) / (a + b + c);
+            iy = (a * py[0] + b * py[1] + c * py[2]) / (a + b + c);
+            r = fabs((px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0])) / (a + b + c);
+            if (t >= r)
+                break;
+
+            for (i = 0; i < 3; i++)
+                addPoint(raster->path, ix + (px[i] - ix) * (r - t) / r, iy + (py[i] - iy) * (r - t) / r, scale_x, scale_y);
+            flushPath(raster);
+            break;
+        }
+        case TESTSHAPE_SHAPE_POLYGON: {
+            gdouble vx, vy;
+            guint i;
+
+            if (!shape->fill) {
+                addStrokePath(raster, shape, TRUE, scale_x, scale_y);
+                return TESTSHAPE_FILL_NONZERO;
+            }
+
+            if (shape->n_points < 3)
+                break;
+
+            for (i = 0; i < shape->n_points; i++) {
+                getVertex(raster, shape, i, &vx, &vy);
+                addPoint(raster->path, vx, vy, scale_x, scale_y);
+            }
+            flushPath(raster);
+            return shape->rule;
+        }
+        case TESTSHAPE_SHAPE_POLYLINE:
+            addStrokePath(raster, shape, FALSE, scale_x, scale_y);
+            return TESTSHAPE_FILL_NONZERO;
+        default:
+            break;
+    }
+
+    return TESTSHAPE_FILL_EVENODD;
+}
+
+/* Rasterizes a polygon or polyline without anti-aliasing, through the scanline filler. */
+static void drawPath(TestshapeRaster *raster, const TestshapeShape *shape)
+{
+    TestshapeFillRule rule;
+
+    g_array_set_size(raster->edges, 0);
+    rule = addShapePath(raster, shape, 1.0, 1.0);
+    fillEdges(raster, rule);
+}
+
+/* Receives the coverage runs of the luma plane. */
+static void addCoverageSpan(gpointer data, gint y, gint x0, gint x1, guint8 coverage)
+{
+    TestshapeRaster *raster = data;
+    TestshapeSpan span;
+
+    span.y = y;
+    span.x0 = x0;
+    span.x1 = x1;
+    span.shape = raster->shape;
+    span.coverage = coverage;
+    g_array_append_val(raster->spans, span);
+}
+
+/* Receives the coverage runs of the chroma planes. */
+static void addChromaCoverageSpan(gpointer data, gint y, gint x0, gint x1, guint8 coverage)
+{
+    TestshapeRaster *raster = data;
+    TestshapeSpan span;
+
+    span.y = y;
+    span.x0 = x0;
+    span.x1 = x1;
+    span.shape = raster->shape;
+    span.coverage = coverage;
+    g_array_append_val(raster->chroma_spans, span);
+}
+
+/* Rasterizes an anti-aliased shape. The chroma coverage is computed on the
+ * subsampled grid itself, each chroma sample gets the part of its own area
+ * inside the shape and is written once.
+ */
+static void drawShapeAntialias(TestshapeRaster *raster, const TestshapeShape *shape)
+{
+    const TestshapeWriter *writer = raster->writer;
+    gint h_sub = 1 << writer->h_shift;
+    gint v_sub = 1 << writer->v_shift;
+    TestshapeFillRule rule;
+
+    gst_testshape_coverage_reset (raster->coverage, raster->clip_x0, raster->clip_y0, raster->clip_x1, raster->clip_y1);
+    rule = addShapePath(raster, shape, 1.0, 1.0);
+    gst_testshape_coverage_sweep (raster->coverage, rule, addCoverageSpan, raster);
+
+    if (!writer->has_chroma)
+        return;
+
+    gst_testshape_coverage_reset (raster->coverage, raster->clip_x0 / h_sub, raster->clip_y0 / v_sub,
+        (raster->clip_x1 + h_sub - 1) / h_sub, (raster->clip_y1 + v_sub - 1) / v_sub);
+    addShapePath(raster, shape, 1.0 / h_sub, 1.0 / v_sub);
+    gst_testshape_coverage_sweep (raster->coverage, rule, addChromaCoverageSpan, raster);
+}
+
+/* Appends the runs of equal coverage of a mask row starting at column x0 to a span list. */
+static void addMaskRow(TestshapeRaster *raster, GArray *spans, gint y, gint x0, const guint8 *row, gint width)
+{
+    TestshapeSpan span;
+    gint x = 0, start;
+
+    span.y = y;
+    span.shape = raster->shape;
+    while (x < width) {
+        start = x;
+        while (x < width && row[x] == row[start])
+            x++;
+
+        if (row[start] == 0)
+            continue;
+
+        span.x0 = x0 + start;
+        span.x1 = x0 + x;
+        span.coverage = row[start];
+        g_array_append_val(spans, span);
+    }
+}
+
+/* Rasterizes a line of text whose top left corner is (x, y). The cached
+ * glyph masks are copied into a coverage mask of the visible part of the
+ * line, aligned on the chroma samples, which is turned into luma spans and,
+ * averaged over every chroma sample, into chroma spans.
+ */
+static void drawText(TestshapeRaster *raster, const TestshapeShape *shape, gint64 x, gint64 y, gint size)
+{
+    const TestshapeWriter *writer = raster->writer;
+    const gchar *text = raster->text + shape->text_offset;
+    const gchar *end = text + shape->text_length, *p;
+    gint h_sub = 1 << writer->h_shift;
+    gint v_sub = 1 << writer->v_shift;
+    gint64 pen, x0, y0, x1, y1, baseline;
+    gint ascent, height, width, rows, skip, i, j;
+    guint8 *mask;
+
+    if (raster->atlas == NULL || size <= 0 || shape->text_length == 0)
+        return;
+
+    /* The box of the line spans the ink of all glyphs. */
+    gst_testshape_atlas_get_metrics (raster->atlas, size, &ascent, &height);
+    baseline = y + ascent;
+    x0 = y0 = G_MAXINT64;
+    x1 = y1 = G_MININT64;
+    for (p = text, pen = x; p < end; p = g_utf8_next_char(p)) {
+        gunichar c = g_utf8_get_char_validated (p, end - p);
+        const TestshapeGlyph *glyph;
+
+        if (c == (gunichar) -1 || c == (gunichar) -2)
+            break;
+
+        glyph = gst_testshape_atlas_get_glyph (raster->atlas, size, c);
+        if (glyph == NULL)
+            continue;
+
+        if (glyph->width > 0 && glyph->height > 0) {
+            x0 = MIN(x0, pen + glyph->left);
+            y0 = MIN(y0, baseline - glyph->top);
+            x1 = MAX(x1, pen + glyph->left + glyph->width);
+            y1 = MAX(y1, baseline - glyph->top + glyph->height);
+        }
+        pen += glyph->advance;
+    }
+
+    /* Only the visible part, widened to whole chroma samples, is masked. */
+    x0 = MAX(x0, raster->clip_x0) & ~(gint64) (h_sub - 1);
+    y0 = MAX(y0, raster->clip_y0) & ~(gint64) (v_sub - 1);
+    x1 = MIN(x1, raster->clip_x1);
+    y1 = MIN(y1, raster->clip_y1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    width = (gint) (x1 - x0);
+    rows = (gint) (y1 - y0);
+    g_array_set_size(raster->mask, (guint) width * rows);
+    mask = (guint8 *) raster->mask->data;
+    memset(mask, 0, (gsize) width * rows);
+
+    for (p = text, pen = x; p < end; p = g_utf8_next_char(p)) {
+        gunichar c = g_utf8_get_char_validated (p, end - p);
+        const TestshapeGlyph *glyph;
+        const guint8 *source;
+        gint64 gx, gy;
+
+        if (c == (gunichar) -1 || c == (gunichar) -2)
+            break;
+
+        glyph = gst_testshape_atlas_get_glyph (raster->atlas, size, c);
+        if (glyph == NULL)
+            continue;
+
+        /* Overlapping glyphs keep the larger coverage. */
+        source = gst_testshape_atlas_get_mask (raster->atlas, glyph);
+        gx = pen + glyph->left;
+        gy = baseline - glyph->top;
+        for (i = (gint) MAX(gy, y0); i < MIN(gy + glyph->height, y1); i++) {
+            const guint8 *from = source + (i - gy) * glyph->width;
+            guint8 *to = mask + (gsize) (i - y0) * width;
+
+            for (j = (gint) MAX(gx, x0); j < MIN(gx + glyph->width, x1); j++)
+                to[j - x0] = MAX(to[j - x0], from[j - gx]);
+        }
+        pen += glyph->advance;
+    }
+
+    /* The mask starts on a chroma sample boundary, its rows above and columns
+     * left of the clip only count in the chroma averages.
+     */
+    skip = (gint) (MAX(x0, raster->clip_x0) - x0);
+    for (i = 0; i < rows; i++) {
+        if (y0 + i >= raster->clip_y0)
+            addMaskRow(raster, raster->spans, (gint) y0 + i, (gint) x0 + skip, mask + (gsize) i * width + skip,
+                width - skip);
+    }
+
+    if (!writer->has_chroma)
+        return;
+
+    /* Every chroma sample gets the average coverage of its luma pixels, the
+     * mask row of the first chroma row is reused for the averages.
+     */
+    for (i = 0; i < rows; i += v_sub) {
+        guint8 *row = mask + (gsize) i * width;
+        gint chroma_width = (width + h_sub - 1) / h_sub;
+
+        for (j = 0; j < chroma_width; j++) {
+            guint sum = 0;
+            gint a, b;
+
+            for (a = i; a < MIN(i + v_sub, rows); a++)
+                for (b = j * h_sub; b < MIN((j + 1) * h_sub, width); b++)
+                    sum += mask[(gsize) a * width + b];
+
+            row[j] = (guint8) ((sum + (h_sub * v_sub) / 2) / (h_sub * v_sub));
+        }
+
+        addMaskRow(raster, raster->chroma_spans, (gint) (y0 + i) >> writer->v_shift, (gint) x0 >> writer->h_shift,
+            row, chroma_width);
+    }
+}
+
+/* Places the stamp of a sprite and rasterizes it into a luma span per row,
+ * from the first to the last visible column. The top left corner is moved
+ * onto a chroma sample, so that the chroma rows of the stamp line up with
+ * those of the frame.
+ */
+static void drawSprite(TestshapeRaster *raster, const TestshapeShape *shape, TestshapePlacedStamp *placed)
+{
+    const TestshapeStamp *stamp = placed->stamp;
+    gint64 bounds[4], y;
+
+    getBounds(raster, shape, bounds);
+    placed->x = bounds[0] & ~(gint64) ((1 << stamp->h_shift) - 1);
+    placed->y = bounds[1] & ~(gint64) ((1 << stamp->v_shift) - 1);
+
+    for (y = MAX(placed->y, raster->clip_y0); y < MIN(placed->y + stamp->height, raster->clip_y1); y++) {
+        const gint *extents = stamp->extents + (y - placed->y) * 2;
+
+        if (extents[0] < extents[1])
+            addSpan(raster, y, placed->x + extents[0], placed->x + extents[1]);
+    }
+}
+
+/* Draws the label of a shape above its top left corner, or inside the top
+ * of the shape when there is no room above it.
+ */
+static void drawLabel(TestshapeRaster *raster, const TestshapeShape *shape)
+{
+    gint64 bounds[4];
+    gint ascent, height;
+
+    if (raster->atlas == NULL || !getBounds(raster, shape, bounds))
+        return;
+
+    gst_testshape_atlas_get_metrics (raster->atlas, raster->font_size, &ascent, &height);
+    drawText(raster, shape, bounds[0], bounds[1] - height >= raster->clip_y0 ? bounds[1] - height : bounds[1],
+        raster->font_size);
+}
+
+/* Converts an ARGB color to full range BT.601 YUV with 8 bit fixed point math,
+ * the RGB values are kept for the RGB formats.
+ */
+void gst_testshape_color_from_argb (guint32 argb, TestshapeColor * color)
+{
+    gint r = (argb >> 16) & 0xff;
+    gint g = (argb >> 8) & 0xff;
+    gint b = argb & 0xff;
+
+    color->y_value = CLAMP((77 * r + 150 * g + 29 * b + 128) >> 8, 0, 255);
+    color->u_value = CLAMP(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255);
+    color->v_value = CLAMP(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255);
+    color->r_value = r;
+    color->g_value = g;
+    color->b_value = b;
+    color->alpha = (argb >> 24) & 0xff;
+}
+
+/* Looks up the YUV and RGB values of a color.
+ * Besides the named colors, "#RRGGBB", "#AARRGGBB" and "0xAARRGGBB" are accepted.
+ * Returns FALSE for unknown colors so that nothing gets drawn.
+ */
+gboolean gst_testshape_color_parse (const gchar *color, TestshapeColor *value)
+{
+    const gchar *digits;
+    gchar *end;
+    guint64 argb;
+
+    if (color == NULL)
+        return FALSE;
+
+    value->alpha = 255;
+
+    /* pixel values are set to red. */
+    if (strcmp(color, "red") == 0) {
+        value->y_value = 76;
+        value->u_value = 84;
+        value->v_value = 255;
+        value->r_value = 255;
+        value->g_value = 0;
+        value->b_value = 0;
+        return TRUE;
+    }
+    /* pixel values are set to green. */
+    else if (strcmp(color, "green") == 0) {
+        value->y_value = 149;
+        value->u_value = 43;
+        value->v_value = 21;
+        value->r_value = 0;
+        value->g_value = 255;
+        value->b_value = 0;
+        return TRUE;
+    }
+    /* pixel values are set to blue. */
+    else if (strcmp(color, "blue") == 0) {
+        value->y_value = 29;
+        value->u_value = 255;
+        value->v_value = 107;
+        value->r_value = 0;
+        value->g_value = 0;
+        value->b_value = 255;
+        return TRUE;
+    }
+
+    if (color[0] == '#')
+        digits = color + 1;
+    else if (color[0] == '0' && (color[1] == 'x' || color[1] == 'X'))
+        digits = color + 2;
+    else
+        return FALSE;
+
+    argb = g_ascii_strtoull(digits, &end, 16);
+    if (*end != '\0')
+        return FALSE;
+
+    /* Six digits are an opaque RGB color, eight carry the alpha too. */
+    if (end - digits == 6)
+        argb |= 0xff000000;
+    else if (end - digits != 8)
+        return FALSE;
+
+    gst_testshape_color_from_argb ((guint32) argb, value);
+
+    return TRUE;
+}
+
+/* Sorts the spans of a shape, from index first on, by row with a stable
+ * counting sort, which keeps the order of the spans within a row. Most shapes
+ * are rasterized row by row and left as they are, a shape with a label has
+ * two runs of rows.
+ */
+static void sortShapeSpans(GArray *spans, guint first, GArray *temp, GArray *row_array)
+{
+    TestshapeSpan *shape_spans = (TestshapeSpan *) spans->data + first;
+    guint n = spans->len - first;
+    gboolean sorted = TRUE;
+    gint y0, y1;
+    guint *rows;
+    guint i, total;
+    gint y;
+
+    if (n == 0)
+        return;
+
+    y0 = y1 = shape_spans[0].y;
+    for (i = 1; i < n; i++) {
+        sorted = sorted && shape_spans[i].y >= shape_spans[i - 1].y;
+        y0 = MIN(y0, shape_spans[i].y);
+        y1 = MAX(y1, shape_spans[i].y);
+    }
+    if (sorted)
+        return;
+
+    g_array_set_size(row_array, y1 - y0 + 1);
+    rows = (guint *) row_array->data;
+    memset(rows, 0, (y1 - y0 + 1) * sizeof(guint));
+    for (i = 0; i < n; i++)
+        rows[shape_spans[i].y - y0]++;
+
+    total = 0;
+    for (y = 0; y <= y1 - y0; y++) {
+        guint count = rows[y];
+        rows[y] = total;
+        total += count;
+    }
+
+    g_array_set_size(temp, n);
+    for (i = 0; i < n; i++)
+        g_array_index(temp, TestshapeSpan, rows[shape_spans[i].y - y0]++) = shape_spans[i];
+    memcpy(shape_spans, temp->data, n * sizeof(TestshapeSpan));
+}
+
+/* Returns the index of the first of n spans sorted by row on row y or below. */
+static guint findRow(const TestshapeSpan *spans, guint n, gint y)
+{
+    guint low = 0, high = n;
+
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+
+        if (spans[middle].y < y)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/* Flags the bins of rows [y0, y1) for sorting. */
+static void markBins(guint8 *dirty, gint y0, gint y1)
+{
+    gint bin;
+
+    for (bin = y0 / TESTSHAPE_BIN_ROWS; y0 < y1 && bin <= (y1 - 1) / TESTSHAPE_BIN_ROWS; bin++)
+        dirty[bin] = TRUE;
+}
+
+/* Builds the hit lists of the n_bins bins of the frame: the indices of the
+ * shapes with spans in each bin, in shape order, bins[b] being the start of
+ * the list of bin b.
+ */
+static void buildBins(TestshapePlan *plan, gint n_bins)
+{
+    const TestshapeShapeCache *cache = (const TestshapeShapeCache *) plan->cache->data;
+    guint *bins, *bin_shapes;
+    guint i, total;
+    gint bin;
+
+    g_array_set_size(plan->bins, n_bins + 1);
+    bins = (guint *) plan->bins->data;
+    memset(bins, 0, (n_bins + 1) * sizeof(guint));
+
+    for (i = 0; i < plan->cache->len; i++) {
+        for (bin = cache[i].y0 / TESTSHAPE_BIN_ROWS; cache[i].y0 < cache[i].y1 && bin <= (cache[i].y1 - 1) / TESTSHAPE_BIN_ROWS; bin++)
+            bins[bin]++;
+    }
+
+    total = 0;
+    for (bin = 0; bin <= n_bins; bin++) {
+        guint count = bins[bin];
+        bins[bin] = total;
+        total += count;
+    }
+
+    g_array_set_size(plan->bin_shapes, total);
+    bin_shapes = (guint *) plan->bin_shapes->data;
+    for (i = 0; i < plan->cache->len; i++) {
+        for (bin = cache[i].y0 / TESTSHAPE_BIN_ROWS; cache[i].y0 < cache[i].y1 && bin <= (cache[i].y1 - 1) / TESTSHAPE_BIN_ROWS; bin++)
+            bin_shapes[bins[bin]++] = i;
+    }
+
+    memmove(bins + 1, bins, n_bins * sizeof(guint));
+    bins[0] = 0;
+}
+
+/* Sorts the spans of the shapes, luma or chroma, into the rows of sorted,
+ * rows[y] being set to the index of the first span of row y out of n_rows
+ * rows, shift being the vertical subsampling of the rows. Within a row the
+ * spans keep their shape order, later shapes stay on top. Bins no changed
+ * shape touches copy their spans from last and last_rows, the sorted spans of
+ * the last rasterization. The others are sorted with a counting sort of the
+ * spans of the shapes of their hit list, which are sorted by row already, so
+ * only the spans inside of the bin are visited.
+ */
+static void sortBins(const TestshapePlan *plan, const GArray *unsorted, gboolean chroma, gint shift,
+    const GArray *last, const GArray *last_rows, GArray *sorted, GArray *row_array, gint n_rows)
+{
+    const TestshapeShapeCache *cache = (const TestshapeShapeCache *) plan->cache->data;
+    const guint *bins = (const guint *) plan->bins->data;
+    const guint *bin_shapes = (const guint *) plan->bin_shapes->data;
+    const guint8 *dirty = (const guint8 *) plan->dirty_bins->data;
+    gint n_bins = plan->bins->len - 1;
+    guint *rows;
+    gint bin, y;
+    guint i, j;
+
+    g_array_set_size(sorted, 0);
+    g_array_set_size(row_array, n_rows + 1);
+    rows = (guint *) row_array->data;
+
+    for (bin = 0; bin < n_bins; bin++) {
+        gint y0 = (bin * TESTSHAPE_BIN_ROWS) >> shift;
+        gint y1 = MIN(((bin + 1) * TESTSHAPE_BIN_ROWS) >> shift, n_rows);
+        guint start = sorted->len, total;
+
+        if (y0 >= y1)
+            continue;
+
+        if (!dirty[bin]) {
+            const guint *from = (const guint *) last_rows->data;
+
+            g_array_append_vals(sorted, (const TestshapeSpan *) last->data + from[y0], from[y1] - from[y0]);
+            for (y = y0; y < y1; y++)
+                rows[y] = from[y] - from[y0] + start;
+            continue;
+        }
+
+        memset(rows + y0, 0, (y1 - y0) * sizeof(guint));
+        for (i = bins[bin]; i < bins[bin + 1]; i++) {
+            const TestshapeShapeCache *shape = &cache[bin_shapes[i]];
+            const TestshapeSpan *spans = (const TestshapeSpan *) unsorted->data + (chroma ? shape->chroma_first : shape->first);
+            guint n = chroma ? shape->n_chroma_spans : shape->n_spans;
+
+            for (j = findRow(spans, n, y0); j < n && spans[j].y < y1; j++)
+                rows[spans[j].y]++;
+        }
+
+        /* Turn the counts into the first span index of every row. */
+        total = start;
+        for (y = y0; y < y1; y++) {
+            guint count = rows[y];
+            rows[y] = total;
+            total += count;
+        }
+
+        g_array_set_size(sorted, total);
+        for (i = bins[bin]; i < bins[bin + 1]; i++) {
+            const TestshapeShapeCache *shape = &cache[bin_shapes[i]];
+            const TestshapeSpan *spans = (const TestshapeSpan *) unsorted->data + (chroma ? shape->chroma_first : shape->first);
+            guint n = chroma ? shape->n_chroma_spans : shape->n_spans;
+
+            for (j = findRow(spans, n, y0); j < n && spans[j].y < y1; j++)
+                g_array_index(sorted, TestshapeSpan, rows[spans[j].y]++) = spans[j];
+        }
+
+        /* The scatter advanced every row start to the start of the next row. */
+        memmove(rows + y0 + 1, rows + y0, (y1 - y0 - 1) * sizeof(guint));
+        rows[y0] = start;
+    }
+
+    rows[n_rows] = sorted->len;
+}
+
+/* Orders chroma runs by their start. */
+static gint compareSpans(gconstpointer a, gconstpointer b)
+{
+    return ((const TestshapeSpan *) a)->x0 - ((const TestshapeSpan *) b)->x0;
+}
+
+/* Emits the chroma spans of chroma row y from the luma coverage summed over
+ * the chroma samples [x0, x1) of sums, in coverage times luma pixels. Each
+ * sample is divided by the number of its luma pixels inside the clip
+ * rectangle, so that the samples on the right and bottom edges of odd sized
+ * frames are weighted by the pixels they really have. The sums are cleared
+ * for the next row.
+ */
+static void addWeightedChromaRow(TestshapeRaster *raster, guint32 *sums, gint base, gint y, gint x0, gint x1)
+{
+    gint h_shift = raster->writer->h_shift;
+    gint v_shift = raster->writer->v_shift;
+    gint rows = MIN((y + 1) << v_shift, raster->clip_y1) - MAX(y << v_shift, raster->clip_y0);
+    TestshapeSpan span;
+    gint x;
+
+    span.y = y;
+    span.shape = raster->shape;
+    span.x0 = x0;
+    span.x1 = x0;
+    span.coverage = 0;
+    for (x = x0; x < x1; x++) {
+        gint area = rows * (MIN((x + 1) << h_shift, raster->clip_x1) - MAX(x << h_shift, raster->clip_x0));
+        guint8 coverage = (guint8) MIN((sums[x - base] + area / 2) / area, 255);
+
+        sums[x - base] = 0;
+        if (coverage == span.coverage) {
+            span.x1++;
+            continue;
+        }
+
+        if (span.coverage > 0)
+            g_array_append_val(raster->chroma_spans, span);
+        span.x0 = x;
+        span.x1 = x + 1;
+        span.coverage = coverage;
+    }
+
+    if (span.coverage > 0)
+        g_array_append_val(raster->chroma_spans, span);
+}
+
+/* Derives the chroma spans of the shape whose luma spans start at index first.
+ * With vertical subsampling the luma rows 2c and 2c+1 share chroma row c. A
+ * luma run [x0, x1) touches the chroma samples [x0 >> h_shift, ((x1 - 1) >> h_shift) + 1),
+ * which rounds odd starts down and odd ends up so that no touched sample is
+ * left out. The runs are mapped to chroma samples and merged, so that every
+ * chroma sample of the shape appears once and is written once, however many
+ * of its luma pixels the shape covers.
+ * With chroma_coverage set the samples on the edges of the shape instead get
+ * the part of their luma pixels the shape covers, as for anti-aliased shapes.
+ */
+static void addChromaSpans(TestshapeRaster *raster, guint first)
+{
+    GArray *spans = raster->spans;
+    GArray *row = raster->chroma_row;
+    gint h_shift = raster->writer->h_shift;
+    gint v_shift = raster->writer->v_shift;
+    gboolean weighted = raster->chroma_coverage && (h_shift > 0 || v_shift > 0);
+    gint base = raster->clip_x0 >> h_shift;
+    guint32 *sums = NULL;
+    guint i = first, j;
+
+    if (weighted) {
+        if (raster->chroma_sums->len == 0 && raster->clip_x1 > raster->clip_x0)
+            g_array_set_size(raster->chroma_sums, (((raster->clip_x1 - 1) >> h_shift) + 1) - base);
+        sums = (guint32 *) raster->chroma_sums->data;
+    }
+
+    while (i < spans->len) {
+        gint chroma_y = g_array_index(spans, TestshapeSpan, i).y >> v_shift;
+        gint row_x0 = G_MAXINT, row_x1 = G_MININT;
+
+        /* Collect the runs of the luma rows in chroma sample units. */
+        g_array_set_size(row, 0);
+        for (; i < spans->len && g_array_index(spans, TestshapeSpan, i).y >> v_shift == chroma_y; i++) {
+            TestshapeSpan span = g_array_index(spans, TestshapeSpan, i);
+            gint x;
+
+            span.y = chroma_y;
+            span.x0 = span.x0 >> h_shift;
+            span.x1 = ((span.x1 - 1) >> h_shift) + 1;
+
+            if (weighted) {
+                const TestshapeSpan *luma = &g_array_index(spans, TestshapeSpan, i);
+
+                /* Add the luma pixels of the run each chroma sample holds. */
+                for (x = span.x0; x < span.x1; x++)
+                    sums[x - base] += (MIN((x + 1) << h_shift, luma->x1) - MAX(x << h_shift, luma->x0)) * luma->coverage;
+                row_x0 = MIN(row_x0, span.x0);
+                row_x1 = MAX(row_x1, span.x1);
+                continue;
+            }
+
+            g_array_append_val(row, span);
+        }
+
+        if (weighted) {
+            addWeightedChromaRow(raster, sums, base, chroma_y, row_x0, row_x1);
+            continue;
+        }
+
+        g_array_sort(row, compareSpans);
+
+        /* Merge overlapping runs and emit them. */
+        for (j = 1; j <= row->len; j++) {
+            TestshapeSpan *merged = &g_array_index(row, TestshapeSpan, 0);
+
+            if (j < row->len && g_array_index(row, TestshapeSpan, j).x0 <= merged->x1) {
+                merged->x1 = MAX(merged->x1, g_array_index(row, TestshapeSpan, j).x1);
+                continue;
+            }
+
+            g_array_append_val(raster->chroma_spans, *merged);
+            if (j < row->len)
+                *merged = g_array_index(row, TestshapeSpan, j);
+        }
+    }
+}
+
+/* Rasterizes shape i of a plan into the spans of the raster. */
+static void rasterizeShape(TestshapePlan *plan, TestshapeRaster *raster, guint i)
+{
+    const TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, i);
+    const TestshapeWriter *writer = plan->writer;
+    guint first = raster->spans->len;
+
+    if (shape->color.alpha == 0)
+        return;
+
+    /* Polygons and polylines must refer to points of the plan. */
+    if ((shape->type == TESTSHAPE_SHAPE_POLYGON || shape->type == TESTSHAPE_SHAPE_POLYLINE) &&
+        (shape->n_points > plan->points->len || shape->first_point > plan->points->len - shape->n_points))
+        return;
+    if (shape->text_length > plan->text->len || shape->text_offset > plan->text->len - shape->text_length)
+        return;
+
+    raster->shape = i;
+    raster->antialias = shape->antialias;
+    raster->chroma_coverage = plan->chroma_coverage;
+    if (shape->type == TESTSHAPE_SHAPE_TEXT) {
+        drawText(raster, shape, shape->x, shape->y, shape->height > 0 ? shape->height : plan->font_size);
+        return;
+    }
+
+    /* The stamps hold the alpha of sprites, their chroma is not weighted. */
+    if (shape->type == TESTSHAPE_SHAPE_SPRITE) {
+        TestshapePlacedStamp *placed = &g_array_index(plan->stamp_scratch, TestshapePlacedStamp, i);
+        const gchar *files = (const gchar *) plan->files->data;
+
+        if (plan->sprites == NULL || shape->sprite_offset >= plan->files->len ||
+            shape->sprite_length >= plan->files->len - shape->sprite_offset ||
+            files[shape->sprite_offset + shape->sprite_length] != '\0')
+            return;
+
+        placed->stamp = gst_testshape_sprites_get_stamp (plan->sprites, files + shape->sprite_offset,
+            shape->width, shape->height, writer, &shape->color);
+        if (placed->stamp == NULL)
+            return;
+
+        drawSprite(raster, shape, placed);
+        raster->chroma_coverage = FALSE;
+        if (writer->has_chroma)
+            addChromaSpans(raster, first);
+        return;
+    }
+
+    if (shape->antialias) {
+        drawShapeAntialias(raster, shape);
+    } else {
+        if (shape->type == TESTSHAPE_SHAPE_POLYGON || shape->type == TESTSHAPE_SHAPE_POLYLINE)
+            drawPath(raster, shape);
+        else
+            drawShape(raster, shape);
+
+        if (writer->has_chroma)
+            addChromaSpans(raster, first);
+    }
+
+    if (shape->text_length > 0)
+        drawLabel(raster, shape);
+}
+
+/* Appends the bytes a shape refers to, its points, text and file name, to data. */
+static void addShapeData(const TestshapePlan *plan, const TestshapeShape *shape, GArray *data)
+{
+    if ((shape->type == TESTSHAPE_SHAPE_POLYGON || shape->type == TESTSHAPE_SHAPE_POLYLINE) &&
+        shape->n_points <= plan->points->len && shape->first_point <= plan->points->len - shape->n_points)
+        g_array_append_vals(data, (const TestshapePoint *) plan->points->data + shape->first_point,
+            shape->n_points * sizeof(TestshapePoint));
+    if (shape->text_length <= plan->text->len && shape->text_offset <= plan->text->len - shape->text_length)
+        g_array_append_vals(data, plan->text->data + shape->text_offset, shape->text_length);
+    if (shape->type == TESTSHAPE_SHAPE_SPRITE && shape->sprite_offset < plan->files->len &&
+        shape->sprite_length < plan->files->len - shape->sprite_offset)
+        g_array_append_vals(data, plan->files->data + shape->sprite_offset, shape->sprite_length + 1);
+}
+
+/* Whether two shapes draw the same spans, given the same points, text and file. */
+static gboolean sameShape(const TestshapeShape *a, const TestshapeShape *b)
+{
+    return a->type == b->type && a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height &&
+        a->thickness == b->thickness && a->fill == b->fill && a->antialias == b->antialias && a->rule == b->rule &&
+        a->n_points == b->n_points && a->text_length == b->text_length && a->sprite_length == b->sprite_length &&
+        a->color.y_value == b->color.y_value && a->color.u_value == b->color.u_value &&
+        a->color.v_value == b->color.v_value && a->color.r_value == b->color.r_value &&
+        a->color.g_value == b->color.g_value && a->color.b_value == b->color.b_value &&
+        a->color.alpha == b->color.alpha;
+}
+
+/* Whether shape i is the shape of its cache entry and refers to the same
+ * bytes, added from data_offset on to the next cache data. Sprites are only
+ * kept with their stamp, a file that could not be loaded before may be now.
+ */
+static gboolean isUnchanged(const TestshapePlan *plan, const TestshapeShapeCache *cached, const TestshapeShape *shape,
+    guint i, guint data_offset)
+{
+    guint length = plan->next_cache_data->len - data_offset;
+
+    if (!sameShape(&cached->shape, shape) || cached->data_length != length)
+        return FALSE;
+    if (length > 0 && memcmp(plan->cache_data->data + cached->data_offset, plan->next_cache_data->data + data_offset, length) != 0)
+        return FALSE;
+
+    return shape->type != TESTSHAPE_SHAPE_SPRITE || g_array_index(plan->stamps, TestshapePlacedStamp, i).stamp != NULL;
+}
+
+/* Sets the rows and pixels of the cache entry of a shape from its spans, the
+ * rows of chroma spans counting for the luma rows they cover.
+ */
+static void setShapeRows(TestshapeShapeCache *cached, const GArray *spans, const GArray *chroma_spans, gint v_shift, gint height)
+{
+    const TestshapeSpan *luma = (const TestshapeSpan *) spans->data + cached->first;
+    const TestshapeSpan *chroma = (const TestshapeSpan *) chroma_spans->data + cached->chroma_first;
+    guint i;
+
+    cached->y0 = G_MAXINT;
+    cached->y1 = 0;
+    cached->pixels = 0;
+    if (cached->n_spans > 0) {
+        cached->y0 = luma[0].y;
+        cached->y1 = luma[cached->n_spans - 1].y + 1;
+    }
+    if (cached->n_chroma_spans > 0) {
+        cached->y0 = MIN(cached->y0, chroma[0].y << v_shift);
+        cached->y1 = MAX(cached->y1, MIN((chroma[cached->n_chroma_spans - 1].y + 1) << v_shift, height));
+    }
+    if (cached->y0 >= cached->y1)
+        cached->y0 = cached->y1 = 0;
+
+    for (i = 0; i < cached->n_spans; i++)
+        cached->pixels += luma[i].x1 - luma[i].x0;
+}
+
+/* Rasterizes all shapes of a plan and sorts the resulting spans by row.
+ * Luma and chroma get their own spans, each at the resolution of its
+ * planes, so that every chroma sample covered by a shape is written once
+ * rather than once per luma pixel.
+ * Only the shapes that changed since the last call are rasterized, the
+ * others copy their spans, and only the bins of rows changed shapes leave or
+ * enter are sorted again.
+ */
+void gst_testshape_plan_rasterize (TestshapePlan * plan, gint width, gint height)
+{
+    const TestshapeWriter *writer = plan->writer;
+    gint n_bins = (height + TESTSHAPE_BIN_ROWS - 1) / TESTSHAPE_BIN_ROWS;
+    TestshapeRaster raster;
+    TestshapeShapeCache *cache;
+    GArray *swap;
+    guint8 *dirty;
+    guint i, n_cached;
+
+    /* A new frame size or setting changes the spans of every shape. */
+    if (!plan->cache_valid || width != plan->cache_width || height != plan->cache_height) {
+        g_array_set_size(plan->cache, 0);
+        g_array_set_size(plan->dirty_bins, n_bins);
+        memset(plan->dirty_bins->data, TRUE, n_bins);
+    } else {
+        g_array_set_size(plan->dirty_bins, n_bins);
+        memset(plan->dirty_bins->data, FALSE, n_bins);
+    }
+    plan->cache_valid = TRUE;
+    plan->cache_width = width;
+    plan->cache_height = height;
+    dirty = (guint8 *) plan->dirty_bins->data;
+
+    /* The spans of the last call are kept aside for the shapes that did not change. */
+    swap = plan->cache_scratch;
+    plan->cache_scratch = plan->scratch;
+    plan->scratch = swap;
+    swap = plan->cache_chroma_scratch;
+    plan->cache_chroma_scratch = plan->chroma_scratch;
+    plan->chroma_scratch = swap;
+    g_array_set_size(plan->scratch, 0);
+    g_array_set_size(plan->chroma_scratch, 0);
+
+    raster.spans = plan->scratch;
+    raster.chroma_spans = plan->chroma_scratch;
+    raster.chroma_row = plan->chroma_row;
+    raster.chroma_sums = plan->chroma_sums;
+    raster.writer = writer;
+    raster.coverage = plan->coverage;
+    raster.path = plan->path;
+    raster.points = (const TestshapePoint *) plan->points->data;
+    raster.edges = plan->edges;
+    raster.active = plan->active;
+    raster.atlas = plan->atlas;
+    raster.font_size = plan->font_size;
+    raster.text = (const gchar *) plan->text->data;
+    raster.mask = plan->mask;
+    raster.clip_x0 = 0;
+    raster.clip_y0 = 0;
+    raster.clip_x1 = width;
+    raster.clip_y1 = height;
+    if (plan->has_clip) {
+        raster.clip_x0 = CLAMP(plan->clip.x, 0, width);
+        raster.clip_y0 = CLAMP(plan->clip.y, 0, height);
+        raster.clip_x1 = (gint) CLAMP((gint64) plan->clip.x + MAX(plan->clip.width, 0), raster.clip_x0, width);
+        raster.clip_y1 = (gint) CLAMP((gint64) plan->clip.y + MAX(plan->clip.height, 0), raster.clip_y0, height);
+    }
+    plan->pixels = 0;
+
+    /* Sized on the first shape with weighted chroma, for the clip of this frame. */
+    g_array_set_size(plan->chroma_sums, 0);
+    g_array_set_size(plan->stamp_scratch, 0);
+    g_array_set_size(plan->stamp_scratch, plan->shapes->len);
+    g_array_set_size(plan->next_cache_data, 0);
+
+    /* Shapes removed since the last call leave their bins. */
+    n_cached = plan->cache->len;
+    cache = (TestshapeShapeCache *) plan->cache->data;
+    for (i = plan->shapes->len; i < n_cached; i++)
+        markBins(dirty, cache[i].y0, cache[i].y1);
+    g_array_set_size(plan->cache, plan->shapes->len);
+    cache = (TestshapeShapeCache *) plan->cache->data;
+
+    for (i = 0; i < plan->shapes->len; i++) {
+        const TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, i);
+        TestshapeShapeCache *cached = &cache[i];
+        guint data_offset = plan->next_cache_data->len;
+        guint first = plan->scratch->len;
+        guint chroma_first = plan->chroma_scratch->len;
+
+        addShapeData(plan, shape, plan->next_cache_data);
+
+        if (i < n_cached && isUnchanged(plan, cached, shape, i, data_offset)) {
+            TestshapeStamp *stamp = g_array_index(plan->stamps, TestshapePlacedStamp, i).stamp;
+
+            g_array_append_vals(plan->scratch, (const TestshapeSpan *) plan->cache_scratch->data + cached->first, cached->n_spans);
+            g_array_append_vals(plan->chroma_scratch, (const TestshapeSpan *) plan->cache_chroma_scratch->data + cached->chroma_first,
+                cached->n_chroma_spans);
+            g_array_index(plan->stamp_scratch, TestshapePlacedStamp, i) = g_array_index(plan->stamps, TestshapePlacedStamp, i);
+            if (stamp != NULL)
+                gst_testshape_stamp_ref (stamp);
+        } else {
+            if (i < n_cached)
+                markBins(dirty, cached->y0, cached->y1);
+
+            rasterizeShape(plan, &raster, i);
+            sortShapeSpans(plan->scratch, first, plan->chroma_row, plan->shape_rows);
+            sortShapeSpans(plan->chroma_scratch, chroma_first, plan->chroma_row, plan->shape_rows);
+            cached->shape = *shape;
+            cached->first = first;
+            cached->n_spans = plan->scratch->len - first;
+            cached->chroma_first = chroma_first;
+            cached->n_chroma_spans = plan->chroma_scratch->len - chroma_first;
+            setShapeRows(cached, plan->scratch, plan->chroma_scratch, writer->v_shift, height);
+            markBins(dirty, cached->y0, cached->y1);
+        }
+
+        cached->data_offset = data_offset;
+        cached->data_length = plan->next_cache_data->len - data_offset;
+        cached->first = first;
+        cached->chroma_first = chroma_first;
+        plan->pixels += cached->pixels;
+    }
+
+    swap = plan->cache_data;
+    plan->cache_data = plan->next_cache_data;
+    plan->next_cache_data = swap;
+
+    /* The sorted spans of the last call are kept aside for the bins that did not change. */
+    swap = plan->last_spans;
+    plan->last_spans = plan->spans;
+    plan->spans = swap;
+    swap = plan->last_rows;
+    plan->last_rows = plan->rows;
+    plan->rows = swap;
+    swap = plan->last_chroma_spans;
+    plan->last_chroma_spans = plan->chroma_spans;
+    plan->chroma_spans = swap;
+    swap = plan->last_chroma_rows;
+    plan->last_chroma_rows = plan->chroma_rows;
+    plan->chroma_rows = swap;
+
+    buildBins(plan, n_bins);
+    sortBins(plan, plan->scratch, FALSE, 0, plan->last_spans, plan->last_rows, plan->spans, plan->rows, height);
+    sortBins(plan, plan->chroma_scratch, TRUE, writer->v_shift, plan->last_chroma_spans, plan->last_chroma_rows,
+        plan->chroma_spans, plan->chroma_rows, GST_VIDEO_SUB_SCALE (writer->v_shift, height));
+
+    /* The new stamps were referenced before the old ones are released, so
+     * sprites that did not change stay in the cache.
+     */
+    releaseStamps(plan->stamps);
+    g_array_append_vals(plan->stamps, plan->stamp_scratch->data, plan->stamp_scratch->len);
+}
+
+/* Returns the color of a span, its alpha scaled by the coverage of the span. */
+static const TestshapeColor *coverColor(const TestshapeColor *color, guint8 coverage, TestshapeColor *scaled)
+{
+    if (coverage == 255)
+        return color;
+
+    *scaled = *color;
+    scaled->alpha = (color->alpha * coverage + 127) / 255;
+    return scaled;
+}
+
+/* Writes the spans of rows [y0, y1) into the frame with the plane writer of its format,
+ * using the color of the shape they belong to. y0 must be even, the chroma rows
+ * of the band are then its own. The luma spans are written first, then the
+ * chroma spans, each sample once. Translucent shapes and partly covered
+ * pixels are blended, sprites blend the matching row of their stamp.
+ */
+void gst_testshape_plan_draw (const TestshapePlan * plan, const TestshapeFillFuncs * funcs, const TestshapeImage * image, gint y0, gint y1)
+{
+    const TestshapeWriter *writer = plan->writer;
+    guint *rows = (guint *) plan->rows->data;
+    guint *chroma_rows = (guint *) plan->chroma_rows->data;
+    guint i;
+
+    for (i = rows[y0]; i < rows[y1]; i++) {
+        const TestshapeSpan *span = &g_array_index(plan->spans, TestshapeSpan, i);
+        const TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, span->shape);
+        const TestshapeColor *color = &shape->color;
+        TestshapeColor scaled;
+
+        if (shape->type == TESTSHAPE_SHAPE_SPRITE) {
+            const TestshapePlacedStamp *placed = &g_array_index(plan->stamps, TestshapePlacedStamp, span->shape);
+            const TestshapeStamp *stamp = placed->stamp;
+            gsize offset = (gsize) (span->y - placed->y) * stamp->luma_stride + (gsize) (span->x0 - placed->x) * stamp->luma_size;
+
+            writer->stamp_y(funcs, image, span->y, span->x0, span->x1, stamp->luma + offset, stamp->luma_inv + offset);
+            continue;
+        }
+
+        if (color->alpha == 255 && span->coverage == 255)
+            writer->fill_y(funcs, image, span->y, span->x0, span->x1, color);
+        else
+            writer->blend_y(funcs, image, span->y, span->x0, span->x1, coverColor(color, span->coverage, &scaled));
+    }
+
+    for (i = chroma_rows[y0 >> writer->v_shift]; i < chroma_rows[GST_VIDEO_SUB_SCALE (writer->v_shift, y1)]; i++) {
+        const TestshapeSpan *span = &g_array_index(plan->chroma_spans, TestshapeSpan, i);
+        const TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, span->shape);
+        const TestshapeColor *color = &shape->color;
+        TestshapeColor scaled;
+
+        if (shape->type == TESTSHAPE_SHAPE_SPRITE) {
+            const TestshapePlacedStamp *placed = &g_array_index(plan->stamps, TestshapePlacedStamp, span->shape);
+            const TestshapeStamp *stamp = placed->stamp;
+            gsize offset = (gsize) (span->y - (placed->y >> stamp->v_shift)) * stamp->chroma_stride +
+                (gsize) (span->x0 - (placed->x >> stamp->h_shift)) * 2;
+
+            writer->stamp_uv(funcs, image, span->y, span->x0, span->x1, stamp->chroma + offset, stamp->chroma_inv + offset);
+            continue;
+        }
+
+        if (color->alpha == 255 && span->coverage == 255)
+            writer->fill_uv(funcs, image, span->y, span->x0, span->x1, color);
+        else
+            writer->blend_uv(funcs, image, span->y, span->x0, span->x1, coverColor(color, span->coverage, &scaled));
+    }
+}
+
+/* Computes the bounding box of the luma spans, FALSE when the plan draws nothing. */
+gboolean gst_testshape_plan_get_extents (const TestshapePlan * plan, TestshapeRect * rect)
+{
+    gint x0 = G_MAXINT, x1 = G_MININT;
+    guint i;
+
+    if (plan->spans->len == 0)
+        return FALSE;
+
+    for (i = 0; i < plan->spans->len; i++) {
+        const TestshapeSpan *span = &g_array_index(plan->spans, TestshapeSpan, i);
+
+        x0 = MIN(x0, span->x0);
+        x1 = MAX(x1, span->x1);
+    }
+
+    /* Spans are sorted by row. */
+    rect->x = x0;
+    rect->y = g_array_index(plan->spans, TestshapeSpan, 0).y;
+    rect->width = x1 - x0;
+    rect->height = g_array_index(plan->spans, TestshapeSpan, plan->spans->len - 1).y + 1 - rect->y;
+
+    return TRUE;
+}
+
+/* Composites a native endian 0xAARRGGBB pixel with straight alpha over another. */
+static guint32 blendArgb(guint32 dst, guint32 src)
+{
+    guint alpha = src >> 24;
+    guint dst_alpha = dst >> 24;
+    guint out_alpha, src_weight, dst_weight, c;
+    guint32 out;
+
+    if (alpha == 255 || dst_alpha == 0)
+        return src;
+
+    /* Straight alpha over operator, with weights scaled by 255. */
+    src_weight = alpha * 255;
+    dst_weight = dst_alpha * (255 - alpha);
+    out_alpha = (src_weight + dst_weight + 127) / 255;
+    out = out_alpha << 24;
+    for (c = 0; c < 24; c += 8) {
+        guint src_value = (src >> c) & 0xff;
+        guint dst_value = (dst >> c) & 0xff;
+
+        out |= ((src_value * src_weight + dst_value * dst_weight + (src_weight + dst_weight) / 2) /
+            (src_weight + dst_weight)) << c;
+    }
+
+    return out;
+}
+
+/* Composites the luma spans over the pixels of an image in native endian
+ * 0xAARRGGBB words with straight alpha, the layout of overlay composition
+ * rectangles. The spans of a row are in shape order, so later shapes end
+ * up on top as when drawing into the frame. Sprites take their pixels from
+ * their stamp.
+ */
+void gst_testshape_plan_render_argb (const TestshapePlan * plan, const TestshapeRect * rect, guint8 * data, gint stride)
+{
+    guint i;
+
+    for (i = 0; i < plan->spans->len; i++) {
+        const TestshapeSpan *span = &g_array_index(plan->spans, TestshapeSpan, i);
+        const TestshapeShape *shape = &g_array_index(plan->shapes, TestshapeShape, span->shape);
+        const TestshapeColor *color = &shape->color;
+        guint32 *pixel = (guint32 *) (data + (gsize) (span->y - rect->y) * stride) + (span->x0 - rect->x);
+        guint alpha = (color->alpha * span->coverage + 127) / 255;
+        guint32 argb = (alpha << 24) | (color->r_value << 16) | (color->g_value << 8) | color->b_value;
+        gint x;
+
+        if (shape->type == TESTSHAPE_SHAPE_SPRITE) {
+            const TestshapePlacedStamp *placed = &g_array_index(plan->stamps, TestshapePlacedStamp, span->shape);
+            const guint32 *src = placed->stamp->argb + (gsize) (span->y - placed->y) * placed->stamp->width +
+                (span->x0 - placed->x);
+
+            for (x = span->x0; x < span->x1; x++, pixel++, src++) {
+                if (*src >> 24 != 0)
+                    *pixel = blendArgb(*pixel, *src);
+            }
+            continue;
+        }
+
+        if (alpha == 0)
+            continue;
+
+        for (x = span->x0; x < span->x1; x++, pixel++)
+            *pixel = blendArgb(*pixel, argb);
+    }
+}
+
+/* Applies an opacity between 0.0 and 1.0 to a color. */
+void gst_testshape_color_set_alpha (TestshapeColor * color, gdouble alpha)
+{
+    color->alpha = (guint8) (color->alpha * CLAMP(alpha, 0.0, 1.0) + 0.5);
+}
+
+/* Maps a shape name onto the shape type used by the draw plan. */
+TestshapeShapeType gst_testshape_shape_type_from_string (const gchar *shape)
+{
+    if (shape == NULL)
+        return TESTSHAPE_SHAPE_NONE;
+
+    if (strcmp(shape, "rectangle") == 0)
+        return TESTSHAPE_SHAPE_RECTANGLE;
+    else if (strcmp(shape, "circle") == 0)
+        return TESTSHAPE_SHAPE_CIRCLE;
+    else if (strcmp(shape, "triangle") == 0)
+        return TESTSHAPE_SHAPE_TRIANGLE;
+    else if (strcmp(shape, "square") == 0)
+        return TESTSHAPE_SHAPE_SQUARE;
+    else if (strcmp(shape, "polygon") == 0)
+        return TESTSHAPE_SHAPE_POLYGON;
+    else if (strcmp(shape, "polyline") == 0)
+        return TESTSHAPE_SHAPE_POLYLINE;
+    else if (strcmp(shape, "text") == 0)
+        return TESTSHAPE_SHAPE_TEXT;
+    else if (strcmp(shape, "sprite") == 0)
+        return TESTSHAPE_SHAPE_SPRITE;
+
+    return TESTSHAPE_SHAPE_NONE;
+}
+
+/* Allocates a plan, rasterizes the shapes and draws them into the whole image. */
+gboolean gst_testshape_draw (GstVideoFormat format, const TestshapeImage * image, gint width, gint height, const TestshapeShape * shapes, guint n_shapes)
+{
+    TestshapePlan plan;
+
+    gst_testshape_plan_init (&plan);
+    if (!gst_testshape_plan_set_format (&plan, format)) {
+        gst_testshape_plan_clear (&plan);
+        return FALSE;
+    }
+
+    g_array_append_vals(plan.shapes, shapes, n_shapes);
+    gst_testshape_plan_rasterize (&plan, width, height);
+    gst_testshape_plan_draw (&plan, gst_testshape_fill_get_funcs (), image, 0, height);
+    gst_testshape_plan_clear (&plan);
+
+    return TRUE;
+}
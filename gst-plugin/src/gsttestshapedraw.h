@@ -0,0 +1,298 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_DRAW_H__
+#define __GST_TESTSHAPE_DRAW_H__
+
+#include <glib.h>
+#include "gsttestshapeatlas.h"
+#include "gsttestshapecoverage.h"
+#include "gsttestshapesprite.h"
+#include "gsttestshapewriter.h"
+
+G_BEGIN_DECLS
+
+/* Shape types. */
+typedef enum
+{
+	TESTSHAPE_SHAPE_NONE,
+	TESTSHAPE_SHAPE_SQUARE,
+	TESTSHAPE_SHAPE_RECTANGLE,
+	TESTSHAPE_SHAPE_TRIANGLE,
+	TESTSHAPE_SHAPE_CIRCLE,
+	TESTSHAPE_SHAPE_POLYGON,
+	TESTSHAPE_SHAPE_POLYLINE,
+	TESTSHAPE_SHAPE_TEXT,
+	TESTSHAPE_SHAPE_SPRITE,
+} TestshapeShapeType;
+
+/* A vertex of a polygon or polyline, in pixels. */
+typedef struct
+{
+	gint x, y;
+} TestshapePoint;
+
+/* One shape to draw, positioned by its center.
+ * width is the rectangle length, the square and triangle size or the circle radius,
+ * height is only used by rectangles. Anti-aliased shapes are rasterized with
+ * subpixel precision and their edge pixels blended by coverage.
+ * Polygons and polylines have the n_points vertices starting at first_point
+ * in the points of the plan, offset by x and y. Filled polygons are filled
+ * with rule, other polygons and polylines are stroked with thickness.
+ * text_length bytes of UTF-8 from text_offset in the text of the plan are
+ * the label of the shape, drawn above it, or the line of a text shape whose
+ * top left corner is x, y and whose pixel size is height, if not 0.
+ * Sprites stamp the image file named by the sprite_length bytes from
+ * sprite_offset in the files of the plan, followed by a NUL, scaled to
+ * width x height with their top left corner at x, y. The color tints masks
+ * and its alpha applies to all sprites.
+ */
+typedef struct
+{
+	TestshapeShapeType type;
+	gint x, y;
+	gint width, height;
+	gint thickness;
+	gboolean fill;
+	gboolean antialias;
+	TestshapeFillRule rule;
+	guint first_point;
+	guint n_points;
+	guint text_offset;
+	guint text_length;
+	guint sprite_offset;
+	guint sprite_length;
+	TestshapeColor color;
+} TestshapeShape;
+
+/* An axis aligned rectangle in frame coordinates. */
+typedef struct
+{
+	gint x, y;
+	gint width, height;
+} TestshapeRect;
+
+/* The stamp of a sprite shape, its top left pixel at x, y in the frame. */
+typedef struct
+{
+	TestshapeStamp *stamp;
+	gint64 x, y;
+} TestshapePlacedStamp;
+
+/* A horizontal run of pixels [x0, x1) on row y that belongs to the shape.
+ * Shapes are rasterized into a list of these spans and only the spans are
+ * written to the frame, so the cost is proportional to the drawn pixels.
+ * coverage is the part of the pixels inside the shape, 255 but on the edges
+ * of anti-aliased shapes.
+ */
+typedef struct
+{
+	gint y;
+	gint x0;
+	gint x1;
+	guint shape;
+	guint8 coverage;
+} TestshapeSpan;
+
+/* Draw plan of a set of shapes for one frame size and format.
+ * It holds everything needed to draw a frame: the shapes and their spans
+ * sorted by row, rows[y] being the index of the first span of row y, and
+ * the writer of the plan format. Rasterization is incremental, shapes that
+ * did not change keep their spans and only the bins of rows they share with
+ * changed shapes are sorted again.
+ */
+typedef struct
+{
+	/* points holds the vertices of the polygons and polylines, text the
+	 * labels and scratch the spans before they are sorted.
+	 */
+	GArray *shapes;
+	GArray *points;
+	GArray *text;
+	GArray *spans;
+	GArray *scratch;
+	GArray *rows;
+	/* Chroma spans at the resolution of the chroma planes, indexed by
+	 * chroma_rows, chroma_row and chroma_sums being scratch space. With
+	 * chroma_coverage the chroma samples on the edges of hard shapes are
+	 * weighted by the part of them inside the shape.
+	 */
+	GArray *chroma_spans;
+	GArray *chroma_scratch;
+	GArray *chroma_rows;
+	GArray *chroma_row;
+	GArray *chroma_sums;
+	gboolean chroma_coverage;
+	/* Drawn luma pixels. */
+	guint64 pixels;
+	const TestshapeWriter *writer;
+	/* Nothing is drawn outside of clip when has_clip is set. */
+	TestshapeRect clip;
+	gboolean has_clip;
+	/* Scratch space of anti-aliased shapes, coverage and path, and of the
+	 * polygon filler, edges and active.
+	 */
+	TestshapeCoverage *coverage;
+	GArray *path;
+	GArray *edges;
+	GArray *active;
+	/* Labels are drawn with the glyphs of atlas at font_size pixels,
+	 * through the scratch mask.
+	 */
+	TestshapeAtlas *atlas;
+	gint font_size;
+	GArray *mask;
+	/* files holds the file names of the sprites, stamps the stamp of every
+	 * sprite shape by shape index and stamp_scratch the stamps of the next
+	 * rasterization.
+	 */
+	TestshapeSprites *sprites;
+	GArray *files;
+	GArray *stamps;
+	GArray *stamp_scratch;
+	/* For every shape, cache keeps the shape as last rasterized, the bytes
+	 * of its points, text or file in cache_data and the range of its spans
+	 * in scratch and chroma_scratch. The spans of the previous rasterization
+	 * are moved to cache_scratch and cache_chroma_scratch, unchanged shapes
+	 * copy theirs from there.
+	 */
+	GArray *cache;
+	GArray *cache_data;
+	GArray *cache_scratch;
+	GArray *cache_chroma_scratch;
+	GArray *next_cache_data;
+	/* Rows are grouped into bins, bins[b] is the index in bin_shapes of the
+	 * hit list of bin b, the shapes with spans in it. Only the bins flagged
+	 * in dirty_bins are sorted again, with shape_rows, the others copy their
+	 * sorted spans from last_spans and last_chroma_spans.
+	 */
+	GArray *shape_rows;
+	GArray *bins;
+	GArray *bin_shapes;
+	GArray *dirty_bins;
+	GArray *last_spans;
+	GArray *last_rows;
+	GArray *last_chroma_spans;
+	GArray *last_chroma_rows;
+	/* The cache holds while cache_valid is set and the frame size stays
+	 * cache_width x cache_height, the setters clear it when a setting the
+	 * spans depend on changes.
+	 */
+	gboolean cache_valid;
+	gint cache_width, cache_height;
+} TestshapePlan;
+
+/* Allocates the arrays of an empty plan, drawing NV12 until another format is set. */
+void gst_testshape_plan_init (TestshapePlan * plan);
+
+/* Frees the arrays of a plan. */
+void gst_testshape_plan_clear (TestshapePlan * plan);
+
+/* Selects the format the plan draws into, returns FALSE if it is not supported. */
+gboolean gst_testshape_plan_set_format (TestshapePlan * plan, GstVideoFormat format);
+
+/* Restricts drawing to the clip rectangle on top of the frame, NULL draws the whole frame. */
+void gst_testshape_plan_set_clip (TestshapePlan * plan, const TestshapeRect * clip);
+
+/* Selects the glyphs and the pixel size of labels, NULL leaves text out. The
+ * atlas is not owned by the plan. The plan keeps the spans of its glyphs, so
+ * it must be given another atlas, or NULL, before the atlas is freed.
+ */
+void gst_testshape_plan_set_font (TestshapePlan * plan, TestshapeAtlas * atlas, gint size);
+
+/* Selects the cache sprites are stamped from, NULL leaves sprites out. Only
+ * files already loaded into the cache are drawn. The cache is not owned by
+ * the plan, it is used while rasterizing.
+ */
+void gst_testshape_plan_set_sprites (TestshapePlan * plan, TestshapeSprites * sprites);
+
+/* Selects how the chroma of the edges of shapes drawn without anti-aliasing is
+ * subsampled: FALSE writes the color into every chroma sample the shape
+ * touches, TRUE blends it by the part of the luma pixels of the sample the
+ * shape covers.
+ */
+void gst_testshape_plan_set_chroma_coverage (TestshapePlan * plan, gboolean chroma_coverage);
+
+/* Rasterizes plan->shapes for a width x height frame, replacing the previous spans.
+ * Only the rows inside the frame and the clip rectangle are visited, shapes
+ * entirely outside of them produce no spans at all. Shapes equal to the shape
+ * of the same index at the last call, with the same points, text or file,
+ * keep their spans, and only the bins of rows where shapes changed are sorted
+ * again, so updating a few shapes out of many costs about their own spans.
+ */
+void gst_testshape_plan_rasterize (TestshapePlan * plan, gint width, gint height);
+
+/* Draws the spans of rows [y0, y1) into the image, y0 being even. Bands of rows
+ * drawn by different threads do not share any pixel.
+ */
+void gst_testshape_plan_draw (const TestshapePlan * plan, const TestshapeFillFuncs * funcs, const TestshapeImage * image, gint y0, gint y1);
+
+/* Sets rect to the bounding box of the drawn pixels, FALSE if there are none. */
+gboolean gst_testshape_plan_get_extents (const TestshapePlan * plan, TestshapeRect * rect);
+
+/* Renders the drawn pixels of the plan over an image of native endian 32 bit
+ * ARGB with straight alpha, whose top left pixel is at rect->x, rect->y in the
+ * frame. The image must cover the extents of the plan and start transparent.
+ */
+void gst_testshape_plan_render_argb (const TestshapePlan * plan, const TestshapeRect * rect, guint8 * data, gint stride);
+
+/* Draws n_shapes shapes into a width x height image in one call. Polygons,
+ * polylines and sprites need the points and sprites of a plan and are not drawn.
+ */
+gboolean gst_testshape_draw (GstVideoFormat format, const TestshapeImage * image, gint width, gint height, const TestshapeShape * shapes, guint n_shapes);
+
+/* Parses a color name or "#RRGGBB", "#AARRGGBB" and "0x" hex, FALSE if unknown. */
+gboolean gst_testshape_color_parse (const gchar * color, TestshapeColor * value);
+
+/* Sets a color from a native endian 0xAARRGGBB value, converted to full range BT.601. */
+void gst_testshape_color_from_argb (guint32 argb, TestshapeColor * color);
+
+/* Scales the alpha of a color by an opacity between 0.0 and 1.0. */
+void gst_testshape_color_set_alpha (TestshapeColor * color, gdouble alpha);
+
+/* Maps a shape name onto its type, TESTSHAPE_SHAPE_NONE if unknown. */
+TestshapeShapeType gst_testshape_shape_type_from_string (const gchar * shape);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_DRAW_H__ */
@@ -0,0 +1,387 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Span fill kernels with runtime CPU dispatch.
+ *
+ * Every kernel has a plain C version. On x86 SSE2 and AVX2 versions are
+ * compiled with target attributes and picked with cpuid at runtime, on
+ * AArch64 the NEON versions are always available.
+ *
+ * Blending uses 8 bit fixed point, dst = (dst * (255 - a) + src * a) / 255,
+ * with the division by 255 done as (t + (t >> 8)) >> 8 after adding 128
+ * for rounding. All intermediate values fit in 16 bits. Stamping adds an
+ * already premultiplied source to the scaled destination with saturation.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include "gsttestshapefill.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TESTSHAPE_FILL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define TESTSHAPE_FILL_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Divides a blended 16 bit value by 255 with rounding already added. */
+#define DIV255(t) (((t) + ((t) >> 8)) >> 8)
+
+/* Plain C kernels, also used for the tails of the SIMD kernels. */
+static void fill_uv_c(guint8 *dst, guint8 u_value, guint8 v_value, gint n)
+{
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        dst[i * 2] = u_value;
+        dst[i * 2 + 1] = v_value;
+    }
+}
+
+static void blend_y_c(guint8 *dst, guint8 y_value, guint8 alpha, gint n)
+{
+    guint src = y_value * alpha + 128;
+    guint inv = 255 - alpha;
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        guint t = dst[i] * inv + src;
+        dst[i] = DIV255(t);
+    }
+}
+
+static void blend_uv_c(guint8 *dst, guint8 u_value, guint8 v_value, guint8 alpha, gint n)
+{
+    guint src_u = u_value * alpha + 128;
+    guint src_v = v_value * alpha + 128;
+    guint inv = 255 - alpha;
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        guint t = dst[i * 2] * inv + src_u;
+        dst[i * 2] = DIV255(t);
+        t = dst[i * 2 + 1] * inv + src_v;
+        dst[i * 2 + 1] = DIV255(t);
+    }
+}
+
+static void stamp_c(guint8 *dst, const guint8 *src, const guint8 *inv, gint n)
+{
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        guint t = dst[i] * inv[i] + 128;
+        dst[i] = MIN(src[i] + DIV255(t), 255);
+    }
+}
+
+static const TestshapeFillFuncs fill_funcs_c = {
+    "c", fill_uv_c, blend_y_c, blend_uv_c, stamp_c
+};
+
+#ifdef TESTSHAPE_FILL_X86
+
+/* SSE2 kernels, 16 bytes per iteration. */
+__attribute__((target("sse2")))
+static void fill_uv_sse2(guint8 *dst, guint8 u_value, guint8 v_value, gint n)
+{
+    __m128i pairs = _mm_set1_epi16((gint16) ((v_value << 8) | u_value));
+
+    for (; n >= 8; n -= 8, dst += 16)
+        _mm_storeu_si128((__m128i *) dst, pairs);
+
+    fill_uv_c(dst, u_value, v_value, n);
+}
+
+/* Blends 16 bytes against the 16 bit source terms of the low and high half. */
+__attribute__((target("sse2")))
+static inline __m128i blend_sse2(__m128i d, __m128i inv, __m128i src)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), src);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), src);
+
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    return _mm_packus_epi16(lo, hi);
+}
+
+__attribute__((target("sse2")))
+static void blend_y_sse2(guint8 *dst, guint8 y_value, guint8 alpha, gint n)
+{
+    __m128i inv = _mm_set1_epi16(255 - alpha);
+    __m128i src = _mm_set1_epi16((gint16) (y_value * alpha + 128));
+
+    for (; n >= 16; n -= 16, dst += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *) dst);
+        _mm_storeu_si128((__m128i *) dst, blend_sse2(d, inv, src));
+    }
+
+    blend_y_c(dst, y_value, alpha, n);
+}
+
+__attribute__((target("sse2")))
+static void blend_uv_sse2(guint8 *dst, guint8 u_value, guint8 v_value, guint8 alpha, gint n)
+{
+    __m128i inv = _mm_set1_epi16(255 - alpha);
+    __m128i src = _mm_set1_epi32((gint) (((guint) (v_value * alpha + 128) << 16) | (u_value * alpha + 128)));
+
+    for (; n >= 8; n -= 8, dst += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *) dst);
+        _mm_storeu_si128((__m128i *) dst, blend_sse2(d, inv, src));
+    }
+
+    blend_uv_c(dst, u_value, v_value, alpha, n);
+}
+
+__attribute__((target("sse2")))
+static void stamp_sse2(guint8 *dst, const guint8 *src, const guint8 *inv, gint n)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi16(128);
+
+    for (; n >= 16; n -= 16, dst += 16, src += 16, inv += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i *) dst);
+        __m128i i = _mm_loadu_si128((const __m128i *) inv);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(i, zero)), round);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(i, zero)), round);
+
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i *) dst, _mm_adds_epu8(_mm_packus_epi16(lo, hi), _mm_loadu_si128((const __m128i *) src)));
+    }
+
+    stamp_c(dst, src, inv, n);
+}
+
+static const TestshapeFillFuncs fill_funcs_sse2 = {
+    "sse2", fill_uv_sse2, blend_y_sse2, blend_uv_sse2, stamp_sse2
+};
+
+/* AVX2 kernels, 32 bytes per iteration. Unpacking and packing both work
+ * within 128 bit lanes, so the byte order is preserved.
+ */
+__attribute__((target("avx2")))
+static void fill_uv_avx2(guint8 *dst, guint8 u_value, guint8 v_value, gint n)
+{
+    __m256i pairs = _mm256_set1_epi16((gint16) ((v_value << 8) | u_value));
+
+    for (; n >= 16; n -= 16, dst += 32)
+        _mm256_storeu_si256((__m256i *) dst, pairs);
+
+    fill_uv_sse2(dst, u_value, v_value, n);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blend_avx2(__m256i d, __m256i inv, __m256i src)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv), src);
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv), src);
+
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+    return _mm256_packus_epi16(lo, hi);
+}
+
+__attribute__((target("avx2")))
+static void blend_y_avx2(guint8 *dst, guint8 y_value, guint8 alpha, gint n)
+{
+    __m256i inv = _mm256_set1_epi16(255 - alpha);
+    __m256i src = _mm256_set1_epi16((gint16) (y_value * alpha + 128));
+
+    for (; n >= 32; n -= 32, dst += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *) dst);
+        _mm256_storeu_si256((__m256i *) dst, blend_avx2(d, inv, src));
+    }
+
+    blend_y_sse2(dst, y_value, alpha, n);
+}
+
+__attribute__((target("avx2")))
+static void blend_uv_avx2(guint8 *dst, guint8 u_value, guint8 v_value, guint8 alpha, gint n)
+{
+    __m256i inv = _mm256_set1_epi16(255 - alpha);
+    __m256i src = _mm256_set1_epi32((gint) (((guint) (v_value * alpha + 128) << 16) | (u_value * alpha + 128)));
+
+    for (; n >= 16; n -= 16, dst += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *) dst);
+        _mm256_storeu_si256((__m256i *) dst, blend_avx2(d, inv, src));
+    }
+
+    blend_uv_sse2(dst, u_value, v_value, alpha, n);
+}
+
+__attribute__((target("avx2")))
+static void stamp_avx2(guint8 *dst, const guint8 *src, const guint8 *inv, gint n)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i round = _mm256_set1_epi16(128);
+
+    for (; n >= 32; n -= 32, dst += 32, src += 32, inv += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i *) dst);
+        __m256i i = _mm256_loadu_si256((const __m256i *) inv);
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(i, zero)), round);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(i, zero)), round);
+
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        _mm256_storeu_si256((__m256i *) dst,
+            _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), _mm256_loadu_si256((const __m256i *) src)));
+    }
+
+    stamp_sse2(dst, src, inv, n);
+}
+
+static const TestshapeFillFuncs fill_funcs_avx2 = {
+    "avx2", fill_uv_avx2, blend_y_avx2, blend_uv_avx2, stamp_avx2
+};
+
+#endif /* TESTSHAPE_FILL_X86 */
+
+#ifdef TESTSHAPE_FILL_NEON
+
+/* NEON kernels, 16 bytes per iteration. */
+static void fill_uv_neon(guint8 *dst, guint8 u_value, guint8 v_value, gint n)
+{
+    uint8x16_t pairs = vreinterpretq_u8_u16(vdupq_n_u16((v_value << 8) | u_value));
+
+    for (; n >= 8; n -= 8, dst += 16)
+        vst1q_u8(dst, pairs);
+
+    fill_uv_c(dst, u_value, v_value, n);
+}
+
+static inline uint8x16_t blend_neon(uint8x16_t d, uint8x8_t inv, uint16x8_t src)
+{
+    uint16x8_t lo = vmlal_u8(src, vget_low_u8(d), inv);
+    uint16x8_t hi = vmlal_u8(src, vget_high_u8(d), inv);
+
+    lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+    hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+static void blend_y_neon(guint8 *dst, guint8 y_value, guint8 alpha, gint n)
+{
+    uint8x8_t inv = vdup_n_u8(255 - alpha);
+    uint16x8_t src = vdupq_n_u16(y_value * alpha + 128);
+
+    for (; n >= 16; n -= 16, dst += 16)
+        vst1q_u8(dst, blend_neon(vld1q_u8(dst), inv, src));
+
+    blend_y_c(dst, y_value, alpha, n);
+}
+
+static void blend_uv_neon(guint8 *dst, guint8 u_value, guint8 v_value, guint8 alpha, gint n)
+{
+    uint8x8_t inv = vdup_n_u8(255 - alpha);
+    uint16x8_t src = vreinterpretq_u16_u32(vdupq_n_u32(((guint) (v_value * alpha + 128) << 16) | (u_value * alpha + 128)));
+
+    for (; n >= 8; n -= 8, dst += 16)
+        vst1q_u8(dst, blend_neon(vld1q_u8(dst), inv, src));
+
+    blend_uv_c(dst, u_value, v_value, alpha, n);
+}
+
+static void stamp_neon(guint8 *dst, const guint8 *src, const guint8 *inv, gint n)
+{
+    uint16x8_t round = vdupq_n_u16(128);
+
+    for (; n >= 16; n -= 16, dst += 16, src += 16, inv += 16) {
+        uint8x16_t d = vld1q_u8(dst);
+        uint8x16_t i = vld1q_u8(inv);
+        uint16x8_t lo = vmlal_u8(round, vget_low_u8(d), vget_low_u8(i));
+        uint16x8_t hi = vmlal_u8(round, vget_high_u8(d), vget_high_u8(i));
+
+        lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+        hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+        vst1q_u8(dst, vqaddq_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)), vld1q_u8(src)));
+    }
+
+    stamp_c(dst, src, inv, n);
+}
+
+static const TestshapeFillFuncs fill_funcs_neon = {
+    "neon", fill_uv_neon, blend_y_neon, blend_uv_neon, stamp_neon
+};
+
+#endif /* TESTSHAPE_FILL_NEON */
+
+/* Picks the kernels once, based on the CPU features. */
+static const TestshapeFillFuncs *gst_testshape_fill_detect (void)
+{
+    const gchar *env = g_getenv ("GST_TESTSHAPE_FILL");
+
+    if (env != NULL && strcmp (env, "scalar") == 0)
+        return &fill_funcs_c;
+
+#if defined(TESTSHAPE_FILL_X86)
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+        return &fill_funcs_avx2;
+    if (__builtin_cpu_supports ("sse2"))
+        return &fill_funcs_sse2;
+#elif defined(TESTSHAPE_FILL_NEON)
+    return &fill_funcs_neon;
+#endif
+
+    return &fill_funcs_c;
+}
+
+const TestshapeFillFuncs *gst_testshape_fill_get_funcs (void)
+{
+    static gsize funcs = 0;
+
+    if (g_once_init_enter (&funcs))
+        g_once_init_leave (&funcs, (gsize) gst_testshape_fill_detect ());
+
+    return (const TestshapeFillFuncs *) funcs;
+}
@@ -0,0 +1,75 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_FILL_H__
+#define __GST_TESTSHAPE_FILL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Span fill kernels used to write the 8 bit YUV planes.
+ * Luma runs are plain byte runs and are written with memset, which libc
+ * already vectorizes. The kernels below cover the interleaved U/V pairs
+ * and the alpha blended runs, n counts bytes for luma and pairs for chroma.
+ * alpha goes from 0 (transparent) to 255 (opaque).
+ * stamp blends n bytes of a premultiplied image over dst, each byte having
+ * its own inverse alpha: dst = src + dst * inv / 255.
+ */
+typedef struct
+{
+	const gchar *name;
+	void (*fill_uv) (guint8 * dst, guint8 u_value, guint8 v_value, gint n);
+	void (*blend_y) (guint8 * dst, guint8 y_value, guint8 alpha, gint n);
+	void (*blend_uv) (guint8 * dst, guint8 u_value, guint8 v_value, guint8 alpha, gint n);
+	void (*stamp) (guint8 * dst, const guint8 * src, const guint8 * inv, gint n);
+} TestshapeFillFuncs;
+
+/* Returns the fastest kernels supported by the CPU, detected on first use.
+ * Setting GST_TESTSHAPE_FILL=scalar in the environment forces the plain C kernels.
+ */
+const TestshapeFillFuncs *gst_testshape_fill_get_funcs (void);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_FILL_H__ */
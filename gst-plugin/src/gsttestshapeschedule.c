@@ -0,0 +1,417 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* PTS keyed overlay schedule.
+ *
+ * Loading a schedule file reads it once to check the PTS order and to record
+ * the offset of every TESTSHAPE_SCHEDULE_INDEX_STEP-th entry. A cursor then
+ * holds the entry active at the last lookup and the entry after it: as the
+ * stream advances the file is read forward line by line, a seek backward or
+ * far ahead repositions the cursor with a binary search of the index. The
+ * entries added while streaming are kept in a PTS sorted array.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gsttestshapeschedule.h"
+
+/* Number of file entries between two index marks. */
+#define TESTSHAPE_SCHEDULE_INDEX_STEP 256
+
+/* Position of an entry of the schedule file. */
+typedef struct
+{
+    GstClockTime pts;
+    gint64 offset;
+} TestshapeScheduleMark;
+
+/* Entry added while streaming. */
+typedef struct
+{
+    GstClockTime pts;
+    guint64 serial;
+    gchar *shapes;
+} TestshapeScheduleEntry;
+
+struct _TestshapeSchedule
+{
+    FILE *file;
+    GArray *index;
+    GString *line;
+
+    /* File cursor: cur is the last entry read with a PTS not after the last
+     * lookup, next the entry following it, read ahead at next_offset.
+     */
+    gboolean cur_valid;
+    GstClockTime cur_pts;
+    gint64 cur_offset;
+    GString *cur_shapes;
+    gboolean next_valid;
+    GstClockTime next_pts;
+    gint64 next_offset;
+    GString *next_shapes;
+
+    GArray *entries;
+    guint64 serial;
+
+    /* Entry returned by the last lookup, by file offset or added entry serial. */
+    gboolean last_valid;
+    gboolean last_added;
+    guint64 last_id;
+};
+
+/* Parses the PTS at the start of a line, nanoseconds or H:MM:SS.nnnnnnnnn,
+ * and returns the shapes after the separating comma. NULL for blank lines,
+ * comments starting with '#' and invalid lines.
+ */
+static const gchar *parseLine(const gchar *line, GstClockTime *pts)
+{
+    const gchar *str = line;
+    gchar *end;
+    guint64 value, h, m, s, frac = 0;
+    guint digits = 0;
+
+    while (g_ascii_isspace (*str))
+        str++;
+    if (*str == '\0' || *str == '#' || !g_ascii_isdigit (*str))
+        return NULL;
+
+    value = g_ascii_strtoull (str, &end, 10);
+    if (*end == ':') {
+        h = value;
+        m = g_ascii_strtoull (end + 1, &end, 10);
+        if (*end != ':')
+            return NULL;
+        s = g_ascii_strtoull (end + 1, &end, 10);
+        if (*end == '.') {
+            for (end++; g_ascii_isdigit (*end); end++) {
+                if (digits++ < 9)
+                    frac = frac * 10 + (*end - '0');
+            }
+            for (; digits < 9; digits++)
+                frac *= 10;
+        }
+        value = ((h * 60 + m) * 60 + s) * GST_SECOND + frac;
+    }
+
+    while (*end == ' ' || *end == '\t')
+        end++;
+    if (*end != ',')
+        return NULL;
+
+    end++;
+    while (g_ascii_isspace (*end))
+        end++;
+
+    *pts = value;
+    return end;
+}
+
+/* Reads one line without its line break, FALSE at the end of the file. */
+static gboolean readLine(FILE *file, GString *line)
+{
+    gchar buf[1024];
+
+    g_string_truncate (line, 0);
+    while (fgets (buf, sizeof (buf), file) != NULL) {
+        g_string_append (line, buf);
+        if (line->len > 0 && line->str[line->len - 1] == '\n') {
+            g_string_truncate (line, line->len - 1);
+            if (line->len > 0 && line->str[line->len - 1] == '\r')
+                g_string_truncate (line, line->len - 1);
+            return TRUE;
+        }
+    }
+
+    return line->len > 0;
+}
+
+/* Reads the file entry following the current file position into next. */
+static void readNext(TestshapeSchedule *schedule)
+{
+    const gchar *shapes;
+
+    schedule->next_valid = FALSE;
+    for (;;) {
+        gint64 offset = ftell (schedule->file);
+
+        if (!readLine (schedule->file, schedule->line))
+            return;
+
+        shapes = parseLine (schedule->line->str, &schedule->next_pts);
+        if (shapes != NULL) {
+            schedule->next_valid = TRUE;
+            schedule->next_offset = offset;
+            g_string_assign (schedule->next_shapes, shapes);
+            return;
+        }
+    }
+}
+
+/* Moves the cursor to the file entry at offset, no entry being active yet. */
+static void seekTo(TestshapeSchedule *schedule, gint64 offset)
+{
+    schedule->cur_valid = FALSE;
+    if (fseek (schedule->file, offset, SEEK_SET) != 0) {
+        schedule->next_valid = FALSE;
+        return;
+    }
+    readNext (schedule);
+}
+
+/* Returns the index of the last mark at or before pts, -1 if there is none. */
+static gint findMark(GArray *index, GstClockTime pts)
+{
+    gint lo = 0, hi = (gint) index->len - 1, found = -1;
+
+    while (lo <= hi) {
+        gint mid = (lo + hi) / 2;
+
+        if (g_array_index (index, TestshapeScheduleMark, mid).pts <= pts) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+/* Advances the file cursor so that cur is the last entry at or before pts. */
+static void lookupFile(TestshapeSchedule *schedule, GstClockTime pts)
+{
+    gint mark;
+
+    if (schedule->file == NULL || schedule->index->len == 0)
+        return;
+
+    mark = findMark (schedule->index, pts);
+
+    if (schedule->cur_valid && pts < schedule->cur_pts) {
+        /* Seek backward: restart from the closest mark. */
+        seekTo (schedule, g_array_index (schedule->index, TestshapeScheduleMark, MAX (mark, 0)).offset);
+    } else if (mark >= 0 && schedule->next_valid && schedule->next_pts <= pts &&
+        g_array_index (schedule->index, TestshapeScheduleMark, mark).offset > schedule->next_offset) {
+        /* Seek forward past a mark: skip the entries in between. */
+        seekTo (schedule, g_array_index (schedule->index, TestshapeScheduleMark, mark).offset);
+    }
+
+    while (schedule->next_valid && schedule->next_pts <= pts) {
+        GString *tmp = schedule->cur_shapes;
+
+        schedule->cur_valid = TRUE;
+        schedule->cur_pts = schedule->next_pts;
+        schedule->cur_offset = schedule->next_offset;
+        schedule->cur_shapes = schedule->next_shapes;
+        schedule->next_shapes = tmp;
+        readNext (schedule);
+    }
+}
+
+/* Returns the index of the last added entry at or before pts, -1 if there is none. */
+static gint findEntry(GArray *entries, GstClockTime pts)
+{
+    gint lo = 0, hi = (gint) entries->len - 1, found = -1;
+
+    while (lo <= hi) {
+        gint mid = (lo + hi) / 2;
+
+        if (g_array_index (entries, TestshapeScheduleEntry, mid).pts <= pts) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+static void clearEntry(gpointer data)
+{
+    TestshapeScheduleEntry *entry = data;
+
+    g_free (entry->shapes);
+}
+
+TestshapeSchedule *gst_testshape_schedule_new (void)
+{
+    TestshapeSchedule *schedule = g_new0 (TestshapeSchedule, 1);
+
+    schedule->index = g_array_new (FALSE, FALSE, sizeof (TestshapeScheduleMark));
+    schedule->line = g_string_new (NULL);
+    schedule->cur_shapes = g_string_new (NULL);
+    schedule->next_shapes = g_string_new (NULL);
+    schedule->entries = g_array_new (FALSE, FALSE, sizeof (TestshapeScheduleEntry));
+    g_array_set_clear_func (schedule->entries, clearEntry);
+
+    return schedule;
+}
+
+void gst_testshape_schedule_free (TestshapeSchedule * schedule)
+{
+    if (schedule->file != NULL)
+        fclose (schedule->file);
+    g_array_free (schedule->index, TRUE);
+    g_string_free (schedule->line, TRUE);
+    g_string_free (schedule->cur_shapes, TRUE);
+    g_string_free (schedule->next_shapes, TRUE);
+    g_array_free (schedule->entries, TRUE);
+    g_free (schedule);
+}
+
+gboolean gst_testshape_schedule_load (TestshapeSchedule * schedule, const gchar * filename)
+{
+    TestshapeScheduleMark mark;
+    GstClockTime pts, last = 0;
+    guint n_entries = 0;
+    gboolean ok = TRUE;
+
+    if (schedule->file != NULL)
+        fclose (schedule->file);
+    schedule->file = NULL;
+    g_array_set_size (schedule->index, 0);
+    schedule->cur_valid = FALSE;
+    schedule->next_valid = FALSE;
+    schedule->last_valid = FALSE;
+
+    if (filename == NULL)
+        return TRUE;
+
+    schedule->file = g_fopen (filename, "rb");
+    if (schedule->file == NULL)
+        return FALSE;
+
+    /* Only the PTS of every line is parsed, the shapes are read when needed. */
+    for (;;) {
+        mark.offset = ftell (schedule->file);
+        if (!readLine (schedule->file, schedule->line))
+            break;
+        if (parseLine (schedule->line->str, &pts) == NULL)
+            continue;
+
+        if (n_entries > 0 && pts < last) {
+            ok = FALSE;
+            break;
+        }
+        if (n_entries % TESTSHAPE_SCHEDULE_INDEX_STEP == 0) {
+            mark.pts = pts;
+            g_array_append_val (schedule->index, mark);
+        }
+        last = pts;
+        n_entries++;
+    }
+
+    if (!ok || ferror (schedule->file)) {
+        fclose (schedule->file);
+        schedule->file = NULL;
+        g_array_set_size (schedule->index, 0);
+        return FALSE;
+    }
+
+    if (schedule->index->len > 0)
+        seekTo (schedule, g_array_index (schedule->index, TestshapeScheduleMark, 0).offset);
+
+    return TRUE;
+}
+
+void gst_testshape_schedule_add (TestshapeSchedule * schedule, GstClockTime pts, const gchar * shapes)
+{
+    TestshapeScheduleEntry entry;
+    gint i = findEntry (schedule->entries, pts);
+
+    entry.pts = pts;
+    entry.serial = ++schedule->serial;
+    entry.shapes = g_strdup (shapes);
+
+    if (i >= 0 && g_array_index (schedule->entries, TestshapeScheduleEntry, i).pts == pts) {
+        TestshapeScheduleEntry *old = &g_array_index (schedule->entries, TestshapeScheduleEntry, i);
+
+        g_free (old->shapes);
+        *old = entry;
+    } else {
+        g_array_insert_val (schedule->entries, i + 1, entry);
+    }
+}
+
+const gchar *gst_testshape_schedule_lookup (TestshapeSchedule * schedule, GstClockTime pts, gboolean * changed)
+{
+    TestshapeScheduleEntry *entry = NULL;
+    const gchar *shapes = NULL;
+    gboolean added = FALSE;
+    guint64 id = 0;
+    gint i;
+
+    lookupFile (schedule, pts);
+
+    /* Added entries before the active one are not needed anymore. */
+    i = findEntry (schedule->entries, pts);
+    if (i > 0)
+        g_array_remove_range (schedule->entries, 0, i);
+    if (i >= 0)
+        entry = &g_array_index (schedule->entries, TestshapeScheduleEntry, 0);
+
+    /* The later entry wins, an added entry wins over a file entry with the same PTS. */
+    if (entry != NULL && (!schedule->cur_valid || entry->pts >= schedule->cur_pts)) {
+        shapes = entry->shapes;
+        added = TRUE;
+        id = entry->serial;
+    } else if (schedule->cur_valid) {
+        shapes = schedule->cur_shapes->str;
+        id = (guint64) schedule->cur_offset;
+    }
+
+    *changed = schedule->last_valid != (shapes != NULL) ||
+        (shapes != NULL && (schedule->last_added != added || schedule->last_id != id));
+    schedule->last_valid = shapes != NULL;
+    schedule->last_added = added;
+    schedule->last_id = id;
+
+    return shapes;
+}
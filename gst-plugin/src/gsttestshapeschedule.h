@@ -0,0 +1,82 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_SCHEDULE_H__
+#define __GST_TESTSHAPE_SCHEDULE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Overlay schedule: shape lists keyed by buffer PTS, each one drawn from its
+ * PTS until the PTS of the next entry. Entries come from a side file with one
+ * "pts,shapes" line per entry in PTS order, pts being in nanoseconds or
+ * H:MM:SS.nnnnnnnnn and shapes using the syntax of the shapes property,
+ * and from entries added while streaming. The file is not loaded, only a
+ * sparse index of it is kept and it is read forward as the stream advances.
+ */
+typedef struct _TestshapeSchedule TestshapeSchedule;
+
+TestshapeSchedule *gst_testshape_schedule_new (void);
+
+void gst_testshape_schedule_free (TestshapeSchedule * schedule);
+
+/* Indexes the schedule file, replacing the previous one. NULL only keeps the
+ * added entries. Returns FALSE if the file cannot be read or is not in PTS order.
+ */
+gboolean gst_testshape_schedule_load (TestshapeSchedule * schedule, const gchar * filename);
+
+/* Adds an entry, replacing an added entry with the same PTS. Added entries
+ * are dropped once a later one is active, live streams only move forward.
+ */
+void gst_testshape_schedule_add (TestshapeSchedule * schedule, GstClockTime pts, const gchar * shapes);
+
+/* Returns the shapes active at pts, NULL before the first entry. changed is
+ * set when they are not the ones returned by the previous lookup. The string
+ * stays valid until the schedule is changed or looked up again.
+ */
+const gchar *gst_testshape_schedule_lookup (TestshapeSchedule * schedule, GstClockTime pts, gboolean * changed);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_SCHEDULE_H__ */
@@ -0,0 +1,480 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Sprite cache of testshape.
+ *
+ * Files are decoded into straight alpha ARGB pixels kept by file name.
+ * Stamps are resampled with premultiplied alpha, averaging the covered
+ * pixels when shrinking and interpolating when enlarging, then converted to
+ * the samples of the planes. A hash table keyed by the size, color, layout
+ * and file finds the stamps converted before.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include "gsttestshapesprite.h"
+#include "gsttestshapedraw.h"
+
+/* A decoded image file. Masks only have alpha. */
+typedef struct
+{
+    gint width, height;
+    gboolean mask;
+    guint32 *argb;
+} TestshapeSource;
+
+struct _TestshapeSprites
+{
+    GHashTable *sources;
+    GHashTable *stamps;
+};
+
+static void freeSource(gpointer data)
+{
+    TestshapeSource *source = data;
+
+    g_free (source->argb);
+    g_free (source);
+}
+
+TestshapeSprites *gst_testshape_sprites_new (void)
+{
+    TestshapeSprites *sprites = g_new0 (TestshapeSprites, 1);
+
+    sprites->sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, freeSource);
+    sprites->stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gst_testshape_stamp_unref);
+
+    return sprites;
+}
+
+void gst_testshape_sprites_free (TestshapeSprites * sprites)
+{
+    g_hash_table_destroy (sprites->sources);
+    g_hash_table_destroy (sprites->stamps);
+    g_free (sprites);
+}
+
+TestshapeStamp *gst_testshape_stamp_ref (TestshapeStamp * stamp)
+{
+    g_atomic_int_inc (&stamp->ref_count);
+    return stamp;
+}
+
+void gst_testshape_stamp_unref (TestshapeStamp * stamp)
+{
+    if (!g_atomic_int_dec_and_test (&stamp->ref_count))
+        return;
+
+    g_free (stamp->luma);
+    g_free (stamp->luma_inv);
+    g_free (stamp->chroma);
+    g_free (stamp->chroma_inv);
+    g_free (stamp->extents);
+    g_free (stamp->argb);
+    g_free (stamp);
+}
+
+/* Reads the next header token of a PNM file, skipping white space and comments. */
+static gboolean readToken(const gchar **p, const gchar *end, gchar *token, gsize size)
+{
+    gsize n = 0;
+
+    while (*p < end && (g_ascii_isspace (**p) || **p == '#')) {
+        if (**p == '#') {
+            while (*p < end && **p != '\n')
+                (*p)++;
+        } else {
+            (*p)++;
+        }
+    }
+
+    while (*p < end && !g_ascii_isspace (**p) && n + 1 < size)
+        token[n++] = *(*p)++;
+    token[n] = '\0';
+
+    return n > 0 && (*p == end || g_ascii_isspace (**p));
+}
+
+static gboolean readNumber(const gchar **p, const gchar *end, guint64 *value)
+{
+    gchar token[24], *token_end;
+
+    if (!readToken(p, end, token, sizeof(token)))
+        return FALSE;
+
+    *value = g_ascii_strtoull (token, &token_end, 10);
+    return *token_end == '\0';
+}
+
+/* Decodes a binary PGM (P5), PPM (P6) or PAM (P7) image. Images with a
+ * single channel are masks, PAM also has gray and RGB with alpha.
+ */
+static gboolean decodeImage(const gchar *data, gsize length, TestshapeSource *source)
+{
+    const gchar *p = data, *end = data + length;
+    guint64 width = 0, height = 0, depth = 0, maxval = 0;
+    gchar token[32];
+    gsize bytes, i;
+
+    if (!readToken(&p, end, token, sizeof(token)))
+        return FALSE;
+
+    if (strcmp(token, "P5") == 0 || strcmp(token, "P6") == 0) {
+        depth = token[1] == '5' ? 1 : 3;
+        if (!readNumber(&p, end, &width) || !readNumber(&p, end, &height) || !readNumber(&p, end, &maxval))
+            return FALSE;
+    } else if (strcmp(token, "P7") == 0) {
+        while (readToken(&p, end, token, sizeof(token)) && strcmp(token, "ENDHDR") != 0) {
+            if (strcmp(token, "WIDTH") == 0 && !readNumber(&p, end, &width))
+                return FALSE;
+            else if (strcmp(token, "HEIGHT") == 0 && !readNumber(&p, end, &height))
+                return FALSE;
+            else if (strcmp(token, "DEPTH") == 0 && !readNumber(&p, end, &depth))
+                return FALSE;
+            else if (strcmp(token, "MAXVAL") == 0 && !readNumber(&p, end, &maxval))
+                return FALSE;
+            else if (strcmp(token, "TUPLTYPE") == 0 && !readToken(&p, end, token, sizeof(token)))
+                return FALSE;
+        }
+        if (strcmp(token, "ENDHDR") != 0)
+            return FALSE;
+    } else {
+        return FALSE;
+    }
+
+    /* A single white space character separates the header from the samples. */
+    if (width == 0 || width > TESTSHAPE_SPRITE_MAX_SIZE || height == 0 || height > TESTSHAPE_SPRITE_MAX_SIZE ||
+        depth == 0 || depth > 4 || maxval == 0 || maxval > 65535 || p == end)
+        return FALSE;
+    p++;
+
+    bytes = maxval > 255 ? 2 : 1;
+    if ((gsize) (end - p) < width * height * depth * bytes)
+        return FALSE;
+
+    source->width = (gint) width;
+    source->height = (gint) height;
+    source->mask = depth == 1;
+    source->argb = g_new (guint32, width * height);
+
+    for (i = 0; i < width * height; i++) {
+        guint value[4], c;
+
+        for (c = 0; c < depth; c++, p += bytes) {
+            guint sample = bytes == 2 ? ((guint8) p[0] << 8) | (guint8) p[1] : (guint8) p[0];
+
+            value[c] = (MIN(sample, maxval) * 255 + maxval / 2) / maxval;
+        }
+
+        switch (depth) {
+            case 1:
+                source->argb[i] = value[0] << 24;
+                break;
+            case 2:
+                source->argb[i] = (value[1] << 24) | (value[0] << 16) | (value[0] << 8) | value[0];
+                break;
+            case 3:
+                source->argb[i] = 0xff000000 | (value[0] << 16) | (value[1] << 8) | value[2];
+                break;
+            default:
+                source->argb[i] = (value[3] << 24) | (value[0] << 16) | (value[1] << 8) | value[2];
+                break;
+        }
+    }
+
+    return TRUE;
+}
+
+gboolean gst_testshape_sprites_load (TestshapeSprites * sprites, const gchar * file, gint * width, gint * height, GError ** error)
+{
+    TestshapeSource *source = g_hash_table_lookup (sprites->sources, file);
+    gchar *data;
+    gsize length;
+
+    if (source == NULL) {
+        if (!g_file_get_contents (file, &data, &length, error))
+            return FALSE;
+
+        source = g_new0 (TestshapeSource, 1);
+        if (!decodeImage(data, length, source)) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a binary PGM, PPM or PAM image of at most "
+                "%dx%d pixels", file, TESTSHAPE_SPRITE_MAX_SIZE, TESTSHAPE_SPRITE_MAX_SIZE);
+            g_free (data);
+            freeSource(source);
+            return FALSE;
+        }
+        g_free (data);
+        g_hash_table_insert (sprites->sources, g_strdup (file), source);
+    }
+
+    *width = source->width;
+    *height = source->height;
+    return TRUE;
+}
+
+/* Resamples n lines of premultiplied A, R, G, B samples along one axis from
+ * src_size to dst_size samples, step floats apart, the lines starting
+ * src_stride and dst_stride floats apart. Shrinking averages the source
+ * samples a destination sample covers, enlarging interpolates between the
+ * two nearest ones.
+ */
+static void resample(const gfloat *src, gfloat *dst, gint src_size, gint dst_size, gint n, gsize step,
+    gsize src_stride, gsize dst_stride)
+{
+    gdouble scale = (gdouble) src_size / dst_size;
+    gint i, j, line, c;
+
+    for (i = 0; i < dst_size; i++) {
+        gdouble x0 = i * scale, x1 = (i + 1) * scale;
+        gdouble center = CLAMP((i + 0.5) * scale - 0.5, 0.0, src_size - 1.0);
+        gint left = (gint) center;
+        gdouble frac = center - left;
+
+        for (line = 0; line < n; line++) {
+            const gfloat *in = src + line * src_stride;
+            gfloat *out = dst + line * dst_stride + i * step;
+            gdouble sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+            if (scale > 1.0) {
+                for (j = (gint) x0; j < x1 && j < src_size; j++) {
+                    gdouble weight = (MIN(x1, j + 1) - MAX(x0, j)) / scale;
+
+                    for (c = 0; c < 4; c++)
+                        sum[c] += weight * in[j * step + c];
+                }
+            } else {
+                for (c = 0; c < 4; c++)
+                    sum[c] = (1.0 - frac) * in[left * step + c] + frac * in[MIN(left + 1, src_size - 1) * step + c];
+            }
+
+            for (c = 0; c < 4; c++)
+                out[c] = (gfloat) sum[c];
+        }
+    }
+}
+
+/* Scales a source to width x height and tints it, returning straight alpha
+ * ARGB pixels. Masks get the color of the shape and every pixel its alpha.
+ */
+static guint32 *scaleSource(const TestshapeSource *source, gint width, gint height, const TestshapeColor *color)
+{
+    gsize src_pixels = (gsize) source->width * source->height;
+    gfloat *pixels = g_new (gfloat, src_pixels * 4);
+    gfloat *rows = g_new (gfloat, (gsize) width * source->height * 4);
+    gfloat *scaled = g_new (gfloat, (gsize) width * height * 4);
+    guint32 *argb = g_new (guint32, (gsize) width * height);
+    gsize i;
+
+    for (i = 0; i < src_pixels; i++) {
+        guint32 value = source->argb[i];
+        gfloat alpha = (value >> 24) / 255.0f;
+
+        pixels[i * 4] = alpha;
+        pixels[i * 4 + 1] = ((value >> 16) & 0xff) * alpha;
+        pixels[i * 4 + 2] = ((value >> 8) & 0xff) * alpha;
+        pixels[i * 4 + 3] = (value & 0xff) * alpha;
+    }
+
+    resample(pixels, rows, source->width, width, source->height, 4, (gsize) source->width * 4, (gsize) width * 4);
+    resample(rows, scaled, source->height, height, width, (gsize) width * 4, 4, 4);
+
+    for (i = 0; i < (gsize) width * height; i++) {
+        gfloat alpha = scaled[i * 4] * color->alpha;
+        guint a = (guint) CLAMP(alpha + 0.5f, 0.0f, 255.0f);
+        guint r, g, b;
+
+        if (a == 0) {
+            argb[i] = 0;
+            continue;
+        }
+
+        if (source->mask) {
+            r = color->r_value;
+            g = color->g_value;
+            b = color->b_value;
+        } else {
+            r = (guint) CLAMP(scaled[i * 4 + 1] / scaled[i * 4] + 0.5f, 0.0f, 255.0f);
+            g = (guint) CLAMP(scaled[i * 4 + 2] / scaled[i * 4] + 0.5f, 0.0f, 255.0f);
+            b = (guint) CLAMP(scaled[i * 4 + 3] / scaled[i * 4] + 0.5f, 0.0f, 255.0f);
+        }
+        argb[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+
+    g_free (pixels);
+    g_free (rows);
+    g_free (scaled);
+    return argb;
+}
+
+/* Converts the pixels of a stamp into premultiplied plane samples. Every
+ * chroma sample is the alpha weighted average of the pixels it covers.
+ */
+static void convertStamp(TestshapeStamp *stamp, gint width, gint height, const guint32 *argb)
+{
+    gint h_sub = 1 << stamp->h_shift, v_sub = 1 << stamp->v_shift;
+    gint x, y, c;
+
+    for (y = 0; y < stamp->height; y++) {
+        guint8 *luma = stamp->luma + (gsize) y * stamp->luma_stride;
+        guint8 *luma_inv = stamp->luma_inv + (gsize) y * stamp->luma_stride;
+
+        stamp->extents[y * 2] = stamp->width;
+        stamp->extents[y * 2 + 1] = 0;
+        for (x = 0; x < stamp->width; x++) {
+            guint32 value = x < width && y < height ? argb[(gsize) y * width + x] : 0;
+            guint alpha = value >> 24;
+            TestshapeColor color;
+
+            stamp->argb[(gsize) y * stamp->width + x] = value;
+            gst_testshape_color_from_argb (value, &color);
+            if (alpha > 0) {
+                stamp->extents[y * 2] = MIN(stamp->extents[y * 2], x);
+                stamp->extents[y * 2 + 1] = x + 1;
+            }
+
+            if (stamp->luma_size == 1) {
+                luma[x] = (color.y_value * alpha + 127) / 255;
+                luma_inv[x] = 255 - alpha;
+            } else {
+                luma[x * 4] = (color.r_value * alpha + 127) / 255;
+                luma[x * 4 + 1] = (color.g_value * alpha + 127) / 255;
+                luma[x * 4 + 2] = (color.b_value * alpha + 127) / 255;
+                luma[x * 4 + 3] = 0;
+                luma_inv[x * 4] = luma_inv[x * 4 + 1] = luma_inv[x * 4 + 2] = 255 - alpha;
+                luma_inv[x * 4 + 3] = 255;
+            }
+        }
+    }
+
+    if (stamp->chroma == NULL)
+        return;
+
+    for (y = 0; y < stamp->height >> stamp->v_shift; y++) {
+        for (x = 0; x < stamp->width >> stamp->h_shift; x++) {
+            guint n = h_sub * v_sub, alpha = 0, u = 0, v = 0, i, j;
+            guint8 *chroma = stamp->chroma + (gsize) y * stamp->chroma_stride + x * 2;
+            guint8 *chroma_inv = stamp->chroma_inv + (gsize) y * stamp->chroma_stride + x * 2;
+
+            for (j = 0; j < (guint) v_sub; j++) {
+                for (i = 0; i < (guint) h_sub; i++) {
+                    guint32 value = stamp->argb[(gsize) ((y << stamp->v_shift) + j) * stamp->width + (x << stamp->h_shift) + i];
+                    TestshapeColor color;
+
+                    gst_testshape_color_from_argb (value, &color);
+                    alpha += color.alpha;
+                    u += color.u_value * color.alpha;
+                    v += color.v_value * color.alpha;
+                }
+            }
+
+            chroma[0] = (u + n * 255 / 2) / (n * 255);
+            chroma[1] = (v + n * 255 / 2) / (n * 255);
+            for (c = 0; c < 2; c++)
+                chroma_inv[c] = 255 - (alpha + n / 2) / n;
+        }
+    }
+}
+
+TestshapeStamp *gst_testshape_sprites_get_stamp (TestshapeSprites * sprites, const gchar * file, gint width, gint height,
+    const TestshapeWriter * writer, const TestshapeColor * color)
+{
+    TestshapeSource *source = g_hash_table_lookup (sprites->sources, file);
+    TestshapeStamp *stamp;
+    guint32 *argb;
+    gchar *key;
+
+    if (source == NULL || width <= 0 || width > TESTSHAPE_SPRITE_MAX_SIZE || height <= 0 ||
+        height > TESTSHAPE_SPRITE_MAX_SIZE)
+        return NULL;
+
+    key = g_strdup_printf ("%dx%d %d%d%d %02x%02x%02x%02x%02x%02x%02x %s", width, height, writer->has_chroma,
+        writer->h_shift, writer->v_shift, color->y_value, color->u_value, color->v_value, color->r_value,
+        color->g_value, color->b_value, color->alpha, file);
+    stamp = g_hash_table_lookup (sprites->stamps, key);
+    if (stamp != NULL) {
+        g_free (key);
+        g_atomic_int_inc (&stamp->ref_count);
+        return stamp;
+    }
+
+    /* Pad the stamp to whole chroma samples, its origin is then a chroma sample as well. */
+    stamp = g_new0 (TestshapeStamp, 1);
+    stamp->h_shift = writer->has_chroma ? writer->h_shift : 0;
+    stamp->v_shift = writer->has_chroma ? writer->v_shift : 0;
+    stamp->width = ((width - 1) | ((1 << stamp->h_shift) - 1)) + 1;
+    stamp->height = ((height - 1) | ((1 << stamp->v_shift) - 1)) + 1;
+    stamp->luma_size = writer->has_chroma ? 1 : 4;
+    stamp->luma_stride = stamp->width * stamp->luma_size;
+    stamp->luma = g_malloc ((gsize) stamp->luma_stride * stamp->height);
+    stamp->luma_inv = g_malloc ((gsize) stamp->luma_stride * stamp->height);
+    if (writer->has_chroma) {
+        stamp->chroma_stride = (stamp->width >> stamp->h_shift) * 2;
+        stamp->chroma = g_malloc ((gsize) stamp->chroma_stride * (stamp->height >> stamp->v_shift));
+        stamp->chroma_inv = g_malloc ((gsize) stamp->chroma_stride * (stamp->height >> stamp->v_shift));
+    }
+    stamp->extents = g_new (gint, (gsize) stamp->height * 2);
+    stamp->argb = g_new (guint32, (gsize) stamp->width * stamp->height);
+    stamp->ref_count = 2;
+
+    argb = scaleSource(source, width, height, color);
+    convertStamp(stamp, width, height, argb);
+    g_free (argb);
+
+    g_hash_table_insert (sprites->stamps, key, stamp);
+    return stamp;
+}
+
+static gboolean isUnused(gpointer key, gpointer value, gpointer data)
+{
+    TestshapeStamp *stamp = value;
+
+    return g_atomic_int_get (&stamp->ref_count) == 1;
+}
+
+void gst_testshape_sprites_trim (TestshapeSprites * sprites)
+{
+    g_hash_table_foreach_remove (sprites->stamps, isUnused, NULL);
+}
@@ -0,0 +1,115 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_SPRITE_H__
+#define __GST_TESTSHAPE_SPRITE_H__
+
+#include <glib.h>
+#include "gsttestshapewriter.h"
+
+G_BEGIN_DECLS
+
+/* Sprite cache for stamped images.
+ * Image files are decoded once. Every size, color and plane layout a sprite
+ * is drawn with is then converted once into a stamp, premultiplied samples
+ * laid out as the planes of the frame, so that drawing a sprite only blends
+ * cached rows. Files without alpha but with a single gray channel are masks,
+ * drawn in the color of the shape.
+ */
+typedef struct _TestshapeSprites TestshapeSprites;
+
+/* Largest width and height of an image file or a sprite. */
+#define TESTSHAPE_SPRITE_MAX_SIZE 4096
+
+/* A sprite converted for one plane layout, width x height pixels padded to
+ * whole chroma samples. luma holds luma_size bytes per pixel, the premultiplied
+ * luma or, without chroma, R, G, B and a padding byte, and chroma a
+ * premultiplied U and V byte per chroma sample. The inv planes hold 255 minus
+ * the alpha of every byte. extents holds the first and last + 1 column of every
+ * row that is not transparent, and argb the pixels in native endian 0xAARRGGBB
+ * with straight alpha. Stamps are shared, the cache and every plan drawing
+ * one hold a reference.
+ */
+typedef struct
+{
+	gint width, height;
+	gint h_shift, v_shift;
+	gint luma_size;
+	gint luma_stride;
+	gint chroma_stride;
+	guint8 *luma;
+	guint8 *luma_inv;
+	guint8 *chroma;
+	guint8 *chroma_inv;
+	gint *extents;
+	guint32 *argb;
+	gint ref_count;
+} TestshapeStamp;
+
+TestshapeSprites *gst_testshape_sprites_new (void);
+
+void gst_testshape_sprites_free (TestshapeSprites * sprites);
+
+/* Decodes an image file on first use and returns its size. PGM, PPM and PAM
+ * files with up to 16 bits per sample are read, FALSE with error set when
+ * the file cannot be read. Files stay cached until the cache is freed.
+ */
+gboolean gst_testshape_sprites_load (TestshapeSprites * sprites, const gchar * file, gint * width, gint * height, GError ** error);
+
+/* Returns a reference to the stamp of a loaded file scaled to width x height,
+ * converting it on first use for the layout of writer. color tints masks and
+ * its alpha applies to every sprite. NULL if the file is not loaded.
+ */
+TestshapeStamp *gst_testshape_sprites_get_stamp (TestshapeSprites * sprites, const gchar * file, gint width, gint height,
+    const TestshapeWriter * writer, const TestshapeColor * color);
+
+/* Drops the stamps only the cache still references. */
+void gst_testshape_sprites_trim (TestshapeSprites * sprites);
+
+/* Takes and drops a reference to a stamp. */
+TestshapeStamp *gst_testshape_stamp_ref (TestshapeStamp * stamp);
+void gst_testshape_stamp_unref (TestshapeStamp * stamp);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_SPRITE_H__ */
@@ -0,0 +1,181 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Lock free performance counters.
+ *
+ * Draw times go into a log-linear histogram: a time is bucketed by its
+ * highest set bit and the TESTSHAPE_STATS_SUB_BITS bits below it, so every
+ * power of two is split into equal steps and the buckets span nanoseconds to
+ * centuries in a fixed array. Each bucket is an atomic counter, recording a
+ * time is one atomic add and percentiles are found by walking the buckets.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gsttestshapestats.h"
+
+#define TESTSHAPE_STATS_SUB_BITS 3
+#define TESTSHAPE_STATS_SUB_BUCKETS (1 << TESTSHAPE_STATS_SUB_BITS)
+#define TESTSHAPE_STATS_BUCKETS ((64 - TESTSHAPE_STATS_SUB_BITS + 1) * TESTSHAPE_STATS_SUB_BUCKETS)
+
+struct _TestshapeStats
+{
+    gsize frames;
+    gsize drawn_frames;
+    gsize spans;
+    gsize pixels;
+    gint buckets[TESTSHAPE_STATS_BUCKETS];
+};
+
+TestshapeStats * gst_testshape_stats_new (void)
+{
+    return g_new0 (TestshapeStats, 1);
+}
+
+void gst_testshape_stats_free (TestshapeStats * stats)
+{
+    g_free(stats);
+}
+
+void gst_testshape_stats_reset (TestshapeStats * stats)
+{
+    guint i;
+
+    g_atomic_pointer_set (&stats->frames, 0);
+    g_atomic_pointer_set (&stats->drawn_frames, 0);
+    g_atomic_pointer_set (&stats->spans, 0);
+    g_atomic_pointer_set (&stats->pixels, 0);
+    for (i = 0; i < TESTSHAPE_STATS_BUCKETS; i++)
+        g_atomic_int_set (&stats->buckets[i], 0);
+}
+
+void gst_testshape_stats_add_frame (TestshapeStats * stats)
+{
+    g_atomic_pointer_add (&stats->frames, 1);
+}
+
+void gst_testshape_stats_add_spans (TestshapeStats * stats, guint n_spans)
+{
+    g_atomic_pointer_add (&stats->spans, n_spans);
+}
+
+/* Maps a time onto its histogram bucket. Times below TESTSHAPE_STATS_SUB_BUCKETS
+ * have a bucket each, the buckets of larger ones follow without a gap.
+ */
+static guint getBucket(guint64 time)
+{
+    guint shift = 0;
+
+    while (time >> shift >= 2 * TESTSHAPE_STATS_SUB_BUCKETS)
+        shift++;
+
+    if (time < TESTSHAPE_STATS_SUB_BUCKETS)
+        return (guint) time;
+
+    return (shift + 1) * TESTSHAPE_STATS_SUB_BUCKETS + (guint) ((time >> shift) - TESTSHAPE_STATS_SUB_BUCKETS);
+}
+
+/* Returns the middle of the times of a bucket. */
+static guint64 getBucketTime(guint bucket)
+{
+    guint shift;
+    guint64 first;
+
+    if (bucket < TESTSHAPE_STATS_SUB_BUCKETS)
+        return bucket;
+
+    shift = bucket / TESTSHAPE_STATS_SUB_BUCKETS - 1;
+    first = (guint64) (TESTSHAPE_STATS_SUB_BUCKETS + bucket % TESTSHAPE_STATS_SUB_BUCKETS) << shift;
+
+    return first + ((G_GUINT64_CONSTANT (1) << shift) >> 1);
+}
+
+void gst_testshape_stats_add_draw (TestshapeStats * stats, GstClockTime time, guint64 pixels)
+{
+    g_atomic_pointer_add (&stats->drawn_frames, 1);
+    g_atomic_pointer_add (&stats->pixels, (gsize) pixels);
+    g_atomic_int_inc (&stats->buckets[getBucket (time)]);
+}
+
+/* Finds the time below which a fraction of the draws fall, counts being the
+ * histogram read once so the percentiles agree with each other.
+ */
+static GstClockTime getPercentile(const guint *counts, guint64 total, gdouble fraction)
+{
+    guint64 rank, seen = 0;
+    guint i;
+
+    if (total == 0)
+        return 0;
+
+    rank = MAX((guint64) (total * fraction + 0.5), 1);
+    for (i = 0; i < TESTSHAPE_STATS_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return getBucketTime (i);
+    }
+
+    return getBucketTime (TESTSHAPE_STATS_BUCKETS - 1);
+}
+
+void gst_testshape_stats_get (TestshapeStats * stats, TestshapeStatsValues * values)
+{
+    guint counts[TESTSHAPE_STATS_BUCKETS];
+    guint64 total = 0;
+    guint i;
+
+    values->frames = (gsize) g_atomic_pointer_get (&stats->frames);
+    values->drawn_frames = (gsize) g_atomic_pointer_get (&stats->drawn_frames);
+    values->spans = (gsize) g_atomic_pointer_get (&stats->spans);
+    values->pixels = (gsize) g_atomic_pointer_get (&stats->pixels);
+
+    for (i = 0; i < TESTSHAPE_STATS_BUCKETS; i++) {
+        counts[i] = (guint) g_atomic_int_get (&stats->buckets[i]);
+        total += counts[i];
+    }
+
+    values->draw_time_p50 = getPercentile (counts, total, 0.50);
+    values->draw_time_p99 = getPercentile (counts, total, 0.99);
+}
@@ -0,0 +1,90 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_STATS_H__
+#define __GST_TESTSHAPE_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Performance counters of the element: frames seen, spans rasterized, pixels
+ * written and a histogram of the draw time of the frames. They are written by
+ * the streaming thread and read from any thread without taking a lock, the
+ * counters are pointer sized and wrap on 32 bit systems.
+ */
+typedef struct _TestshapeStats TestshapeStats;
+
+/* A snapshot of the counters, draw times in nanoseconds. */
+typedef struct
+{
+	guint64 frames;
+	guint64 drawn_frames;
+	guint64 spans;
+	guint64 pixels;
+	GstClockTime draw_time_p50;
+	GstClockTime draw_time_p99;
+} TestshapeStatsValues;
+
+TestshapeStats *gst_testshape_stats_new (void);
+
+void gst_testshape_stats_free (TestshapeStats * stats);
+
+/* Clears the counters and the histogram. */
+void gst_testshape_stats_reset (TestshapeStats * stats);
+
+/* Counts a frame handled by the element, drawn into or not. */
+void gst_testshape_stats_add_frame (TestshapeStats * stats);
+
+/* Counts the spans of a rasterized plan. */
+void gst_testshape_stats_add_spans (TestshapeStats * stats, guint n_spans);
+
+/* Records a drawn frame, the time its draw took and the pixels written. */
+void gst_testshape_stats_add_draw (TestshapeStats * stats, GstClockTime time, guint64 pixels);
+
+/* Reads the counters, the percentiles are accurate to 1/16 of their value. */
+void gst_testshape_stats_get (TestshapeStats * stats, TestshapeStatsValues * values);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_STATS_H__ */
@@ -0,0 +1,134 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Persistent worker pool used to draw row bands in parallel.
+ *
+ * The pool is an exclusive GThreadPool, its threads are started with the
+ * runner and stay alive until it is freed, so no thread is created per frame.
+ * The caller works on the first task itself and then waits for the others.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gsttestshapetask.h"
+
+struct _TestshapeTaskRunner
+{
+    guint n_threads;
+    GThreadPool *pool;
+    TestshapeTaskFunc func;
+    GMutex lock;
+    GCond cond;
+    guint pending;
+};
+
+/* Entry point of the worker threads. */
+static void gst_testshape_task_runner_worker (gpointer task, gpointer user_data)
+{
+    TestshapeTaskRunner *runner = user_data;
+
+    runner->func (task);
+
+    g_mutex_lock (&runner->lock);
+    if (--runner->pending == 0)
+        g_cond_signal (&runner->cond);
+    g_mutex_unlock (&runner->lock);
+}
+
+TestshapeTaskRunner *gst_testshape_task_runner_new (guint n_threads)
+{
+    TestshapeTaskRunner *runner = g_new0 (TestshapeTaskRunner, 1);
+
+    runner->n_threads = MAX (n_threads, 1);
+    g_mutex_init (&runner->lock);
+    g_cond_init (&runner->cond);
+
+    if (runner->n_threads > 1) {
+        runner->pool = g_thread_pool_new (gst_testshape_task_runner_worker, runner,
+            runner->n_threads - 1, TRUE, NULL);
+        /* Without worker threads everything runs on the calling thread. */
+        if (runner->pool == NULL)
+            runner->n_threads = 1;
+    }
+
+    return runner;
+}
+
+void gst_testshape_task_runner_free (TestshapeTaskRunner * runner)
+{
+    if (runner->pool != NULL)
+        g_thread_pool_free (runner->pool, FALSE, TRUE);
+    g_mutex_clear (&runner->lock);
+    g_cond_clear (&runner->cond);
+    g_free (runner);
+}
+
+guint gst_testshape_task_runner_get_n_threads (TestshapeTaskRunner * runner)
+{
+    return runner->n_threads;
+}
+
+void gst_testshape_task_runner_run (TestshapeTaskRunner * runner, TestshapeTaskFunc func, gpointer * tasks, guint n_tasks)
+{
+    guint i;
+
+    g_return_if_fail (n_tasks <= runner->n_threads);
+
+    if (n_tasks == 0)
+        return;
+
+    runner->func = func;
+    runner->pending = n_tasks - 1;
+
+    for (i = 1; i < n_tasks; i++)
+        g_thread_pool_push (runner->pool, tasks[i], NULL);
+
+    func (tasks[0]);
+
+    g_mutex_lock (&runner->lock);
+    while (runner->pending > 0)
+        g_cond_wait (&runner->cond, &runner->lock);
+    g_mutex_unlock (&runner->lock);
+}
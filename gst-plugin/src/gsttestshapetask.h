@@ -0,0 +1,74 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_TASK_H__
+#define __GST_TESTSHAPE_TASK_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Runs a batch of tasks in parallel on a persistent pool of worker threads,
+ * modeled after GstParallelizedTaskRunner of gst-video. The threads are
+ * created once with the runner, running a batch only queues the tasks.
+ */
+typedef struct _TestshapeTaskRunner TestshapeTaskRunner;
+
+typedef void (*TestshapeTaskFunc) (gpointer task);
+
+/* Creates a runner for n_threads tasks at a time, the calling thread included. */
+TestshapeTaskRunner *gst_testshape_task_runner_new (guint n_threads);
+
+void gst_testshape_task_runner_free (TestshapeTaskRunner * runner);
+
+guint gst_testshape_task_runner_get_n_threads (TestshapeTaskRunner * runner);
+
+/* Calls func on each of the n_tasks tasks and returns once all are done.
+ * The first task runs on the calling thread, n_tasks must not exceed the
+ * number of threads of the runner.
+ */
+void gst_testshape_task_runner_run (TestshapeTaskRunner * runner, TestshapeTaskFunc func, gpointer * tasks, guint n_tasks);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_TASK_H__ */
@@ -0,0 +1,373 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Plane writers of the supported formats.
+ *
+ * The semi-planar and planar 8 bit formats use the SIMD span kernels,
+ * NV21 being NV12 with U and V swapped and I420 writing U and V as two
+ * plain byte runs. Packed YUY2 and RGBx as well as the 16 bit samples of
+ * P010 are written with plain loops.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include "gsttestshapewriter.h"
+
+/* Divides a blended 16 bit value by 255 with rounding already added. */
+#define DIV255(t) (((t) + ((t) >> 8)) >> 8)
+
+#define PLANE(image, plane, x, y, size) \
+    ((image)->data[plane] + (y) * (image)->stride[plane] + (x) * (size))
+
+/* Blends one 8 bit sample, src being value * alpha + 128 and inv 255 - alpha. */
+static inline guint8 blendSample(guint8 dst, guint src, guint inv)
+{
+    guint t = dst * inv + src;
+
+    return DIV255(t);
+}
+
+/* Blends one premultiplied 8 bit sample of a stamp. */
+static inline guint8 stampSample(guint8 dst, guint8 src, guint8 inv)
+{
+    guint t = dst * inv + 128;
+
+    return MIN(src + DIV255(t), 255);
+}
+
+/* NV12: Y plane and interleaved U/V plane. */
+static void fill_y_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    memset(PLANE(image, 0, x0, y, 1), color->y_value, x1 - x0);
+}
+
+static void blend_y_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->blend_y(PLANE(image, 0, x0, y, 1), color->y_value, color->alpha, x1 - x0);
+}
+
+static void fill_uv_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->fill_uv(PLANE(image, 1, x0, y, 2), color->u_value, color->v_value, x1 - x0);
+}
+
+static void blend_uv_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->blend_uv(PLANE(image, 1, x0, y, 2), color->u_value, color->v_value, color->alpha, x1 - x0);
+}
+
+static void stamp_y_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    funcs->stamp(PLANE(image, 0, x0, y, 1), src, inv, x1 - x0);
+}
+
+static void stamp_uv_nv12(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    funcs->stamp(PLANE(image, 1, x0, y, 2), src, inv, (x1 - x0) * 2);
+}
+
+/* NV21: NV12 with V before U. */
+static void fill_uv_nv21(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->fill_uv(PLANE(image, 1, x0, y, 2), color->v_value, color->u_value, x1 - x0);
+}
+
+static void blend_uv_nv21(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->blend_uv(PLANE(image, 1, x0, y, 2), color->v_value, color->u_value, color->alpha, x1 - x0);
+}
+
+static void stamp_uv_nv21(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint8 *dst = PLANE(image, 1, x0, y, 2);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2, src += 2, inv += 2) {
+        dst[0] = stampSample(dst[0], src[1], inv[1]);
+        dst[1] = stampSample(dst[1], src[0], inv[0]);
+    }
+}
+
+/* I420: separate U and V planes, each run is a plain byte run. */
+static void fill_uv_i420(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    memset(PLANE(image, 1, x0, y, 1), color->u_value, x1 - x0);
+    memset(PLANE(image, 2, x0, y, 1), color->v_value, x1 - x0);
+}
+
+static void blend_uv_i420(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    funcs->blend_y(PLANE(image, 1, x0, y, 1), color->u_value, color->alpha, x1 - x0);
+    funcs->blend_y(PLANE(image, 2, x0, y, 1), color->v_value, color->alpha, x1 - x0);
+}
+
+static void stamp_uv_i420(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint8 *dst_u = PLANE(image, 1, x0, y, 1);
+    guint8 *dst_v = PLANE(image, 2, x0, y, 1);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst_u++, dst_v++, src += 2, inv += 2) {
+        *dst_u = stampSample(*dst_u, src[0], inv[0]);
+        *dst_v = stampSample(*dst_v, src[1], inv[1]);
+    }
+}
+
+/* YUY2: packed Y0 U Y1 V, chroma subsampled horizontally only. */
+static void fill_y_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 2);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2)
+        dst[0] = color->y_value;
+}
+
+static void blend_y_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 2);
+    guint src = color->y_value * color->alpha + 128;
+    guint inv = 255 - color->alpha;
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2)
+        dst[0] = blendSample(dst[0], src, inv);
+}
+
+static void fill_uv_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 4);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 4) {
+        dst[1] = color->u_value;
+        dst[3] = color->v_value;
+    }
+}
+
+static void blend_uv_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 4);
+    guint src_u = color->u_value * color->alpha + 128;
+    guint src_v = color->v_value * color->alpha + 128;
+    guint inv = 255 - color->alpha;
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 4) {
+        dst[1] = blendSample(dst[1], src_u, inv);
+        dst[3] = blendSample(dst[3], src_v, inv);
+    }
+}
+
+static void stamp_y_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 2);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2, src++, inv++)
+        dst[0] = stampSample(dst[0], *src, *inv);
+}
+
+static void stamp_uv_yuy2(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 4);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 4, src += 2, inv += 2) {
+        dst[1] = stampSample(dst[1], src[0], inv[0]);
+        dst[3] = stampSample(dst[3], src[1], inv[1]);
+    }
+}
+
+/* P010: NV12 layout with 10 bit samples in the high bits of little endian 16 bit words.
+ * 8 bit values are widened by replicating their top bits.
+ */
+static inline guint to10(guint8 value)
+{
+    return (value << 2) | (value >> 6);
+}
+
+static inline guint16 blend10(guint16 dst, guint src, guint alpha)
+{
+    guint value = GUINT16_FROM_LE(dst) >> 6;
+
+    value = (value * (255 - alpha) + src * alpha + 127) / 255;
+
+    return GUINT16_TO_LE(value << 6);
+}
+
+static void fill_y_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 0, x0, y, 2);
+    guint16 value = GUINT16_TO_LE(to10(color->y_value) << 6);
+    gint x;
+
+    for (x = x0; x < x1; x++)
+        *dst++ = value;
+}
+
+static void blend_y_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 0, x0, y, 2);
+    guint src = to10(color->y_value);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst++)
+        *dst = blend10(*dst, src, color->alpha);
+}
+
+static void fill_uv_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 1, x0, y, 4);
+    guint16 u_value = GUINT16_TO_LE(to10(color->u_value) << 6);
+    guint16 v_value = GUINT16_TO_LE(to10(color->v_value) << 6);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2) {
+        dst[0] = u_value;
+        dst[1] = v_value;
+    }
+}
+
+static void blend_uv_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 1, x0, y, 4);
+    guint src_u = to10(color->u_value);
+    guint src_v = to10(color->v_value);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2) {
+        dst[0] = blend10(dst[0], src_u, color->alpha);
+        dst[1] = blend10(dst[1], src_v, color->alpha);
+    }
+}
+
+/* Blends a premultiplied 8 bit sample over a 10 bit one. */
+static inline guint16 stamp10(guint16 dst, guint8 src, guint8 inv)
+{
+    guint value = GUINT16_FROM_LE(dst) >> 6;
+
+    value = MIN(to10(src) + (value * inv + 127) / 255, 1023);
+
+    return GUINT16_TO_LE(value << 6);
+}
+
+static void stamp_y_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 0, x0, y, 2);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst++, src++, inv++)
+        *dst = stamp10(*dst, *src, *inv);
+}
+
+static void stamp_uv_p010(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    guint16 *dst = (guint16 *) PLANE(image, 1, x0, y, 4);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 2, src += 2, inv += 2) {
+        dst[0] = stamp10(dst[0], src[0], inv[0]);
+        dst[1] = stamp10(dst[1], src[1], inv[1]);
+    }
+}
+
+/* RGBx: packed R G B and a padding byte, the luma runs write whole pixels. */
+static void fill_y_rgbx(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 4);
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 4) {
+        dst[0] = color->r_value;
+        dst[1] = color->g_value;
+        dst[2] = color->b_value;
+    }
+}
+
+static void blend_y_rgbx(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const TestshapeColor *color)
+{
+    guint8 *dst = PLANE(image, 0, x0, y, 4);
+    guint src_r = color->r_value * color->alpha + 128;
+    guint src_g = color->g_value * color->alpha + 128;
+    guint src_b = color->b_value * color->alpha + 128;
+    guint inv = 255 - color->alpha;
+    gint x;
+
+    for (x = x0; x < x1; x++, dst += 4) {
+        dst[0] = blendSample(dst[0], src_r, inv);
+        dst[1] = blendSample(dst[1], src_g, inv);
+        dst[2] = blendSample(dst[2], src_b, inv);
+    }
+}
+
+/* The padding byte of a stamp is transparent, the whole pixel is one kernel run. */
+static void stamp_y_rgbx(const TestshapeFillFuncs *funcs, const TestshapeImage *image, gint y, gint x0, gint x1, const guint8 *src, const guint8 *inv)
+{
+    funcs->stamp(PLANE(image, 0, x0, y, 4), src, inv, (x1 - x0) * 4);
+}
+
+static const TestshapeWriter writers[] = {
+    { GST_VIDEO_FORMAT_NV12, TRUE, 1, 1, fill_y_nv12, blend_y_nv12, fill_uv_nv12, blend_uv_nv12, stamp_y_nv12, stamp_uv_nv12 },
+    { GST_VIDEO_FORMAT_NV21, TRUE, 1, 1, fill_y_nv12, blend_y_nv12, fill_uv_nv21, blend_uv_nv21, stamp_y_nv12, stamp_uv_nv21 },
+    { GST_VIDEO_FORMAT_I420, TRUE, 1, 1, fill_y_nv12, blend_y_nv12, fill_uv_i420, blend_uv_i420, stamp_y_nv12, stamp_uv_i420 },
+    { GST_VIDEO_FORMAT_YUY2, TRUE, 1, 0, fill_y_yuy2, blend_y_yuy2, fill_uv_yuy2, blend_uv_yuy2, stamp_y_yuy2, stamp_uv_yuy2 },
+    { GST_VIDEO_FORMAT_P010_10LE, TRUE, 1, 1, fill_y_p010, blend_y_p010, fill_uv_p010, blend_uv_p010, stamp_y_p010,
+        stamp_uv_p010 },
+    { GST_VIDEO_FORMAT_RGBx, FALSE, 0, 0, fill_y_rgbx, blend_y_rgbx, NULL, NULL, stamp_y_rgbx, NULL },
+};
+
+const TestshapeWriter *gst_testshape_writer_get (GstVideoFormat format)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (writers); i++) {
+        if (writers[i].format == format)
+            return &writers[i];
+    }
+
+    return NULL;
+}
@@ -0,0 +1,105 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TESTSHAPE_WRITER_H__
+#define __GST_TESTSHAPE_WRITER_H__
+
+#include <gst/video/video.h>
+#include "gsttestshapefill.h"
+
+G_BEGIN_DECLS
+
+/* Formats the shapes can be drawn into, in caps syntax. */
+#define TESTSHAPE_WRITER_FORMATS "{ NV12, NV21, I420, YUY2, P010_10LE, RGBx }"
+
+/* A color in YUV and RGB with its opacity, alpha 255 being opaque. */
+typedef struct
+{
+	guint8 y_value, u_value, v_value;
+	guint8 r_value, g_value, b_value;
+	guint8 alpha;
+} TestshapeColor;
+
+/* Planes of the image being drawn, as mapped by the caller. */
+typedef struct
+{
+	guint8 *data[GST_VIDEO_MAX_PLANES];
+	gint stride[GST_VIDEO_MAX_PLANES];
+} TestshapeImage;
+
+/* Writes runs of a color into the planes of one video format.
+ * Luma runs cover the pixels [x0, x1) of row y, for RGB formats they write
+ * the whole pixel. Chroma runs cover the chroma samples [x0, x1) of chroma
+ * row y, chroma being subsampled by h_shift and v_shift. Formats without
+ * separate chroma samples have has_chroma set to FALSE and get no chroma runs.
+ * The blend variants mix the color in according to its alpha.
+ * The stamp variants blend a premultiplied image instead of a color, src
+ * and inv holding the samples and their inverse alpha from the sample of x0
+ * on: one byte per luma pixel, or R, G, B and padding bytes for RGB formats,
+ * and a U and a V byte per chroma sample.
+ */
+typedef void (*TestshapeWriteFunc) (const TestshapeFillFuncs * funcs, const TestshapeImage * image,
+    gint y, gint x0, gint x1, const TestshapeColor * color);
+
+typedef void (*TestshapeStampFunc) (const TestshapeFillFuncs * funcs, const TestshapeImage * image,
+    gint y, gint x0, gint x1, const guint8 * src, const guint8 * inv);
+
+typedef struct
+{
+	GstVideoFormat format;
+	gboolean has_chroma;
+	gint h_shift, v_shift;
+	TestshapeWriteFunc fill_y;
+	TestshapeWriteFunc blend_y;
+	TestshapeWriteFunc fill_uv;
+	TestshapeWriteFunc blend_uv;
+	TestshapeStampFunc stamp_y;
+	TestshapeStampFunc stamp_uv;
+} TestshapeWriter;
+
+/* Returns the writer of a format, NULL if the format is not supported. */
+const TestshapeWriter *gst_testshape_writer_get (GstVideoFormat format);
+
+G_END_DECLS
+
+#endif /* __GST_TESTSHAPE_WRITER_H__ */
@@ -0,0 +1,529 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* testshape-golden checks the drawing core against checksums of known good frames.
+ *
+ * Every shape type is drawn outlined, filled and anti-aliased into every
+ * format, in an even frame and in an odd sized one that the shape crosses on
+ * its right and bottom edges, both through gst_testshape_draw() and through a
+ * plan drawn in two bands. A scene of all the shapes is drawn too, whole and
+ * clipped, after an incremental update of its plan. The MD5 of the visible
+ * bytes of the planes must match the line of the case in the golden file and
+ * the padding after the rows must be left untouched. Text is not checked, its
+ * glyphs depend on the FreeType version and the installed fonts.
+ *
+ * Usage: testshape-golden GOLDEN_FILE
+ *        testshape-golden --generate > GOLDEN_FILE
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gsttestshapedraw.h"
+
+/* Bytes after every row, which drawing must not touch. */
+#define PADDING 16
+#define PADDING_BYTE 0xa5
+
+/* Band boundary of the plan draws, even as gst_testshape_plan_draw() wants it. */
+#define BAND_ROWS 16
+
+static const GstVideoFormat formats[] = {
+    GST_VIDEO_FORMAT_NV12,
+    GST_VIDEO_FORMAT_NV21,
+    GST_VIDEO_FORMAT_I420,
+    GST_VIDEO_FORMAT_YUY2,
+    GST_VIDEO_FORMAT_P010_10LE,
+    GST_VIDEO_FORMAT_RGBx,
+};
+
+static const gchar *shape_names[] = { "square", "rectangle", "triangle", "circle", "polygon", "polyline", "sprite", "mask" };
+static const gchar *style_names[] = { "outline", "fill", "antialias" };
+
+/* An even frame and an odd one, with the center of the shapes in each. */
+static const gint frame_sizes[][4] = { { 64, 48, 32, 24 }, { 63, 37, 51, 29 } };
+
+/* The clip rectangle of the clipped scene, on odd coordinates. */
+static const TestshapeRect scene_clip = { 7, 5, 31, 23 };
+
+/* The planes of a frame as the fill kernels see them, each row followed by PADDING bytes. */
+typedef struct
+{
+    GstVideoFormat format;
+    gint width, height;
+    guint n_planes;
+    gint row_bytes[3];
+    gint rows[3];
+    guint8 *data;
+    gsize size;
+    TestshapeImage image;
+} Frame;
+
+static void frame_init (Frame * frame, GstVideoFormat format, gint width, gint height)
+{
+    gint half_width = (width + 1) / 2, half_height = (height + 1) / 2;
+    gsize offset = 0;
+    guint p;
+
+    memset (frame, 0, sizeof (*frame));
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+
+    switch (format) {
+        case GST_VIDEO_FORMAT_NV12:
+        case GST_VIDEO_FORMAT_NV21:
+            frame->n_planes = 2;
+            frame->row_bytes[0] = width;
+            frame->rows[0] = height;
+            frame->row_bytes[1] = half_width * 2;
+            frame->rows[1] = half_height;
+            break;
+        case GST_VIDEO_FORMAT_I420:
+            frame->n_planes = 3;
+            frame->row_bytes[0] = width;
+            frame->rows[0] = height;
+            frame->row_bytes[1] = frame->row_bytes[2] = half_width;
+            frame->rows[1] = frame->rows[2] = half_height;
+            break;
+        case GST_VIDEO_FORMAT_YUY2:
+            frame->n_planes = 1;
+            frame->row_bytes[0] = half_width * 4;
+            frame->rows[0] = height;
+            break;
+        case GST_VIDEO_FORMAT_P010_10LE:
+            frame->n_planes = 2;
+            frame->row_bytes[0] = width * 2;
+            frame->rows[0] = height;
+            frame->row_bytes[1] = half_width * 4;
+            frame->rows[1] = half_height;
+            break;
+        default:
+            frame->n_planes = 1;
+            frame->row_bytes[0] = width * 4;
+            frame->rows[0] = height;
+            break;
+    }
+
+    for (p = 0; p < frame->n_planes; p++)
+        frame->size += (gsize) (frame->row_bytes[p] + PADDING) * frame->rows[p];
+    frame->data = g_malloc (frame->size);
+    for (p = 0; p < frame->n_planes; p++) {
+        frame->image.data[p] = frame->data + offset;
+        frame->image.stride[p] = frame->row_bytes[p] + PADDING;
+        offset += (gsize) frame->image.stride[p] * frame->rows[p];
+    }
+}
+
+static void frame_clear (Frame * frame)
+{
+    g_free (frame->data);
+    frame->data = NULL;
+}
+
+/* Fills the planes with a gradient, so blending shows in the checksums, and the padding with PADDING_BYTE. */
+static void frame_reset (Frame * frame)
+{
+    guint p;
+    gint x, y;
+
+    for (p = 0; p < frame->n_planes; p++) {
+        for (y = 0; y < frame->rows[p]; y++) {
+            guint8 *row = frame->image.data[p] + (gsize) y * frame->image.stride[p];
+
+            for (x = 0; x < frame->row_bytes[p]; x++)
+                row[x] = (guint8) (16 + (x + 3 * y + 50 * p) % 200);
+            memset (row + frame->row_bytes[p], PADDING_BYTE, PADDING);
+        }
+    }
+}
+
+/* Returns the MD5 of the visible bytes of the planes, to be freed. */
+static gchar *frame_checksum (const Frame * frame)
+{
+    GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
+    gchar *digest;
+    guint p;
+    gint y;
+
+    for (p = 0; p < frame->n_planes; p++)
+        for (y = 0; y < frame->rows[p]; y++)
+            g_checksum_update (checksum, frame->image.data[p] + (gsize) y * frame->image.stride[p], frame->row_bytes[p]);
+    digest = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+
+    return digest;
+}
+
+static gboolean frame_padding_untouched (const Frame * frame)
+{
+    guint p;
+    gint x, y;
+
+    for (p = 0; p < frame->n_planes; p++) {
+        for (y = 0; y < frame->rows[p]; y++) {
+            const guint8 *row = frame->image.data[p] + (gsize) y * frame->image.stride[p];
+
+            for (x = frame->row_bytes[p]; x < frame->row_bytes[p] + PADDING; x++)
+                if (row[x] != PADDING_BYTE)
+                    return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Writes a 7x5 PAM with an alpha gradient and a 9x9 PGM disc mask to use as sprites. */
+static gboolean write_sprites (gchar ** image_file, gchar ** mask_file)
+{
+    GString *image = g_string_new ("P7\nWIDTH 7\nHEIGHT 5\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n");
+    GString *mask = g_string_new ("P5\n9 9\n255\n");
+    GError *err = NULL;
+    gint x, y, fd;
+
+    for (y = 0; y < 5; y++) {
+        for (x = 0; x < 7; x++) {
+            g_string_append_c (image, (gchar) (x * 36));
+            g_string_append_c (image, (gchar) (y * 60));
+            g_string_append_c (image, (gchar) (255 - x * 30));
+            g_string_append_c (image, (gchar) (x == 0 ? 0 : 255 - y * 50));
+        }
+    }
+    for (y = 0; y < 9; y++)
+        for (x = 0; x < 9; x++)
+            g_string_append_c (mask, (gchar) ((x - 4) * (x - 4) + (y - 4) * (y - 4) <= 16 ? 255 : 0));
+
+    *image_file = NULL;
+    *mask_file = NULL;
+    if ((fd = g_file_open_tmp ("testshape-XXXXXX.pam", image_file, &err)) >= 0) {
+        g_close (fd, NULL);
+        if (g_file_set_contents (*image_file, image->str, image->len, &err) &&
+            (fd = g_file_open_tmp ("testshape-XXXXXX.pgm", mask_file, &err)) >= 0) {
+            g_close (fd, NULL);
+            g_file_set_contents (*mask_file, mask->str, mask->len, &err);
+        }
+    }
+    g_string_free (image, TRUE);
+    g_string_free (mask, TRUE);
+
+    if (err != NULL) {
+        g_printerr ("cannot write the sprites: %s\n", err->message);
+        g_clear_error (&err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Appends a shape of the named type and style centered on x, y to the plan,
+ * with its points or file. size is the size of its box.
+ */
+static void add_shape (TestshapePlan * plan, const gchar * name, guint style, gint x, gint y, gint size,
+    const gchar * image_file, const gchar * mask_file)
+{
+    static const TestshapePoint star[] = { { 0, -12 }, { 4, -3 }, { 13, -3 }, { 6, 3 }, { 9, 12 }, { 0, 6 }, { -9, 12 },
+        { -6, 3 }, { -13, -3 }, { -4, -3 } };
+    static const TestshapePoint zigzag[] = { { -13, 9 }, { -6, -10 }, { 1, 8 }, { 7, -11 }, { 13, 6 } };
+    TestshapeShape shape;
+    const gchar *file = NULL;
+
+    memset (&shape, 0, sizeof (shape));
+    shape.type = gst_testshape_shape_type_from_string (name);
+    shape.x = x;
+    shape.y = y;
+    shape.width = shape.type == TESTSHAPE_SHAPE_CIRCLE ? size / 2 : size;
+    shape.height = size * 2 / 3;
+    shape.thickness = 3;
+    shape.fill = style != 0;
+    shape.antialias = style == 2;
+    shape.rule = TESTSHAPE_FILL_EVENODD;
+
+    /* Opaque outlines, half transparent fills and three quarters opaque anti-aliased shapes. */
+    gst_testshape_color_parse (style == 0 ? "red" : style == 1 ? "blue" : "green", &shape.color);
+    gst_testshape_color_set_alpha (&shape.color, style == 0 ? 1.0 : style == 1 ? 0.5 : 0.75);
+
+    if (shape.type == TESTSHAPE_SHAPE_POLYGON || shape.type == TESTSHAPE_SHAPE_POLYLINE) {
+        shape.first_point = plan->points->len;
+        if (shape.type == TESTSHAPE_SHAPE_POLYGON) {
+            shape.n_points = G_N_ELEMENTS (star);
+            g_array_append_vals (plan->points, star, shape.n_points);
+        } else {
+            shape.n_points = G_N_ELEMENTS (zigzag);
+            g_array_append_vals (plan->points, zigzag, shape.n_points);
+        }
+    } else if (strcmp (name, "sprite") == 0) {
+        file = image_file;
+    } else if (strcmp (name, "mask") == 0) {
+        shape.type = TESTSHAPE_SHAPE_SPRITE;
+        file = mask_file;
+    }
+
+    if (file != NULL) {
+        shape.sprite_offset = plan->files->len;
+        shape.sprite_length = strlen (file);
+        g_array_append_vals (plan->files, file, shape.sprite_length + 1);
+        shape.width = size - 7;
+        shape.height = size / 2 + 1;
+    }
+
+    g_array_append_val (plan->shapes, shape);
+}
+
+/* Resets the plan to draw into format, without shapes. */
+static void reset_plan (TestshapePlan * plan, GstVideoFormat format, TestshapeSprites * sprites)
+{
+    gst_testshape_plan_set_format (plan, format);
+    gst_testshape_plan_set_sprites (plan, sprites);
+    gst_testshape_plan_set_clip (plan, NULL);
+    g_array_set_size (plan->shapes, 0);
+    g_array_set_size (plan->points, 0);
+    g_array_set_size (plan->files, 0);
+}
+
+/* Draws the plan into the frame in two bands. */
+static void draw_plan (const TestshapePlan * plan, Frame * frame)
+{
+    const TestshapeFillFuncs *funcs = gst_testshape_fill_get_funcs ();
+
+    frame_reset (frame);
+    gst_testshape_plan_draw (plan, funcs, &frame->image, 0, MIN (BAND_ROWS, frame->height));
+    if (frame->height > BAND_ROWS)
+        gst_testshape_plan_draw (plan, funcs, &frame->image, BAND_ROWS, frame->height);
+}
+
+/* Checks the frame and appends the line of the case to lines, FALSE on a failed check. */
+static gboolean add_case (GString * lines, const Frame * frame, const gchar * shape, const gchar * style)
+{
+    gchar *digest;
+
+    if (!frame_padding_untouched (frame)) {
+        g_printerr ("%s %dx%d %s %s: drawn over the end of a row\n", gst_video_format_to_string (frame->format),
+            frame->width, frame->height, shape, style);
+        return FALSE;
+    }
+
+    digest = frame_checksum (frame);
+    g_string_append_printf (lines, "%s %dx%d %s %s %s\n", gst_video_format_to_string (frame->format), frame->width,
+        frame->height, shape, style, digest);
+    g_free (digest);
+
+    return TRUE;
+}
+
+/* Draws every case into lines, FALSE if a check that needs no golden file failed. */
+static gboolean run_cases (GString * lines, TestshapeSprites * sprites, const gchar * image_file, const gchar * mask_file)
+{
+    TestshapePlan plan;
+    gboolean ok = TRUE;
+    guint f, z, s, t;
+
+    gst_testshape_plan_init (&plan);
+
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        for (z = 0; z < G_N_ELEMENTS (frame_sizes); z++) {
+            gint width = frame_sizes[z][0], height = frame_sizes[z][1];
+            Frame frame, direct;
+
+            frame_init (&frame, formats[f], width, height);
+            frame_init (&direct, formats[f], width, height);
+
+            for (s = 0; s < G_N_ELEMENTS (shape_names); s++) {
+                TestshapeShapeType type = gst_testshape_shape_type_from_string (shape_names[s]);
+                gboolean sprite = type == TESTSHAPE_SHAPE_SPRITE || type == TESTSHAPE_SHAPE_NONE;
+
+                /* Sprites have no outline or anti-aliasing, they are drawn once. */
+                for (t = 0; t < (sprite ? 1 : G_N_ELEMENTS (style_names)); t++) {
+                    reset_plan (&plan, formats[f], sprites);
+                    add_shape (&plan, shape_names[s], sprite ? 1 : t, frame_sizes[z][2], frame_sizes[z][3], 30 - z * 3,
+                        image_file, mask_file);
+                    gst_testshape_plan_rasterize (&plan, width, height);
+                    draw_plan (&plan, &frame);
+                    ok &= add_case (lines, &frame, shape_names[s], sprite ? "stamp" : style_names[t]);
+
+                    /* Polygons, polylines and sprites need the points and the files of a plan. */
+                    if (type >= TESTSHAPE_SHAPE_SQUARE && type <= TESTSHAPE_SHAPE_CIRCLE) {
+                        frame_reset (&direct);
+                        gst_testshape_draw (formats[f], &direct.image, width, height, (TestshapeShape *) plan.shapes->data, 1);
+                        if (memcmp (frame.data, direct.data, frame.size) != 0) {
+                            g_printerr ("%s %dx%d %s %s: gst_testshape_draw() differs from the plan\n",
+                                gst_video_format_to_string (formats[f]), width, height, shape_names[s], style_names[t]);
+                            ok = FALSE;
+                        }
+                    }
+                }
+            }
+
+            frame_clear (&direct);
+            frame_clear (&frame);
+        }
+    }
+
+    /* A scene of every shape in every style in the odd frame, drawn whole
+     * and clipped. Its plan is first rasterized with a shape moved, so the
+     * spans drawn come from an incremental update.
+     */
+    for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+        gint width = frame_sizes[1][0], height = frame_sizes[1][1];
+        Frame frame;
+        guint clipped;
+
+        frame_init (&frame, formats[f], width, height);
+        for (clipped = 0; clipped < 2; clipped++) {
+            TestshapeShape *moved;
+
+            reset_plan (&plan, formats[f], sprites);
+            for (s = 0; s < G_N_ELEMENTS (shape_names); s++)
+                add_shape (&plan, shape_names[s], s % G_N_ELEMENTS (style_names), 5 + (s * 17) % width, 3 + (s * 11) % height,
+                    13 + s % 5, image_file, mask_file);
+            if (clipped)
+                gst_testshape_plan_set_clip (&plan, &scene_clip);
+
+            moved = &g_array_index (plan.shapes, TestshapeShape, 3);
+            moved->x += 40;
+            gst_testshape_plan_rasterize (&plan, width, height);
+            moved->x -= 40;
+            gst_testshape_plan_rasterize (&plan, width, height);
+
+            draw_plan (&plan, &frame);
+            ok &= add_case (lines, &frame, "scene", clipped ? "clip" : "whole");
+        }
+        frame_clear (&frame);
+    }
+
+    gst_testshape_plan_clear (&plan);
+
+    return ok;
+}
+
+/* Compares the lines with the golden file, printing the cases that differ. */
+static gboolean compare_golden (const gchar * lines, const gchar * golden_file)
+{
+    gchar *contents = NULL, **expected, **actual;
+    GError *err = NULL;
+    gboolean ok = TRUE;
+    guint i, j;
+
+    if (!g_file_get_contents (golden_file, &contents, NULL, &err)) {
+        g_printerr ("cannot read %s: %s\n", golden_file, err->message);
+        g_clear_error (&err);
+        return FALSE;
+    }
+
+    expected = g_strsplit (contents, "\n", -1);
+    actual = g_strsplit (lines, "\n", -1);
+    for (i = 0, j = 0; expected[i] != NULL || actual[j] != NULL;) {
+        /* Empty lines and comments of the golden file are skipped. */
+        if (expected[i] != NULL && (expected[i][0] == '\0' || expected[i][0] == '#')) {
+            i++;
+            continue;
+        }
+        if (actual[j] != NULL && actual[j][0] == '\0') {
+            j++;
+            continue;
+        }
+        if (expected[i] == NULL || actual[j] == NULL || strcmp (expected[i], actual[j]) != 0) {
+            g_printerr ("expected: %s\n     got: %s\n", expected[i] != NULL ? expected[i] : "(end)",
+                actual[j] != NULL ? actual[j] : "(end)");
+            ok = FALSE;
+        }
+        if (expected[i] != NULL)
+            i++;
+        if (actual[j] != NULL)
+            j++;
+    }
+
+    g_strfreev (expected);
+    g_strfreev (actual);
+    g_free (contents);
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    gboolean generate = argc == 2 && strcmp (argv[1], "--generate") == 0;
+    gchar *image_file, *mask_file;
+    TestshapeSprites *sprites;
+    GString *lines;
+    gboolean ok;
+    gint width, height;
+    GError *err = NULL;
+
+    if (argc != 2) {
+        g_printerr ("usage: %s GOLDEN_FILE | --generate\n", argv[0]);
+        return 1;
+    }
+
+    if (!write_sprites (&image_file, &mask_file))
+        return 1;
+
+    sprites = gst_testshape_sprites_new ();
+    ok = gst_testshape_sprites_load (sprites, image_file, &width, &height, &err) &&
+        gst_testshape_sprites_load (sprites, mask_file, &width, &height, &err);
+    if (!ok) {
+        g_printerr ("cannot load the sprites: %s\n", err->message);
+        g_clear_error (&err);
+    }
+
+    lines = g_string_new (NULL);
+    if (ok)
+        ok = run_cases (lines, sprites, image_file, mask_file);
+
+    if (generate)
+        g_print ("%s", lines->str);
+    else if (ok)
+        ok = compare_golden (lines->str, argv[1]);
+
+    g_string_free (lines, TRUE);
+    gst_testshape_sprites_free (sprites);
+    g_unlink (image_file);
+    g_unlink (mask_file);
+    g_free (image_file);
+    g_free (mask_file);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* testshape-bench measures the throughput of the testshape element.
+ *
+ * Frames from a recycling buffer pool are pushed through
+ * appsrc ! testshape ! fakesink as fast as possible, so the result does not
+ * depend on any framerate. For every combination of shape type, size,
+ * resolution and shape count it prints frames per second and nanoseconds per
+ * frame, along with the draw cost left after subtracting a run in which
+ * testshape is in passthrough.
+ *
+ * Usage: testshape-bench [--shape=circle] [--size=256] [--resolution=1920x1080]
+ *                        [--count=16] [--frames=300] [--format=NV12] [--fill]
+ *                        [--alpha=1.0] [--n-threads=1]
+ * Without a --shape, --size, --resolution or --count the default sweep is used
+ * for that dimension.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+
+/* Parameters of one benchmark run. */
+typedef struct
+{
+    const gchar *shape;
+    gint size;
+    gint width, height;
+    gint count;
+    gint frames;
+    const gchar *format;
+    gboolean fill;
+    gdouble alpha;
+    guint n_threads;
+} BenchConfig;
+
+static const gchar *default_shapes[] = { "square", "rectangle", "triangle", "circle" };
+static const gint default_sizes[] = { 32, 256 };
+static const gint default_resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+static const gint default_counts[] = { 1, 16 };
+
+/* Builds the shapes property: count shapes of the given type spread on a grid,
+ * each one fitting in a size x size box.
+ */
+static gchar *make_shapes(const BenchConfig *cfg)
+{
+    GString *shapes = g_string_new (NULL);
+    gint cols = 1, i;
+
+    while (cols * cols < cfg->count)
+        cols++;
+
+    for (i = 0; i < cfg->count; i++) {
+        gint x = (i % cols) * cfg->width / cols + cfg->width / (2 * cols);
+        gint y = (i / cols) * cfg->height / cols + cfg->height / (2 * cols);
+
+        g_string_append_printf (shapes, "%s%s, x=%d, y=%d, fill=%s, ", i ? "; " : "",
+            cfg->shape, x, y, cfg->fill ? "true" : "false");
+
+        if (strcmp (cfg->shape, "rectangle") == 0)
+            g_string_append_printf (shapes, "width=%d, height=%d", cfg->size, cfg->size / 2);
+        else if (strcmp (cfg->shape, "circle") == 0)
+            g_string_append_printf (shapes, "radius=%d", cfg->size / 2);
+        else
+            g_string_append_printf (shapes, "size=%d", cfg->size);
+    }
+
+    return g_string_free (shapes, FALSE);
+}
+
+/* Pushes cfg->frames frames through testshape and returns the elapsed time per
+ * frame in nanoseconds, or a negative value on error. Without shapes the
+ * element stays in passthrough, which gives the cost of the pipeline itself.
+ */
+static gdouble run_bench(const BenchConfig *cfg, gboolean draw)
+{
+    GstElement *pipeline, *src, *testshape, *sink;
+    GstBufferPool *pool;
+    GstStructure *config;
+    GstVideoInfo info;
+    GstCaps *caps;
+    GstBus *bus;
+    GstMessage *msg;
+    gint64 start, end;
+    gdouble result = -1.0;
+    gint i;
+
+    gst_video_info_set_format (&info, gst_video_format_from_string (cfg->format), cfg->width, cfg->height);
+    caps = gst_video_info_to_caps (&info);
+
+    pipeline = gst_pipeline_new (NULL);
+    src = gst_element_factory_make ("appsrc", NULL);
+    testshape = gst_element_factory_make ("testshape", NULL);
+    sink = gst_element_factory_make ("fakesink", NULL);
+    if (src == NULL || testshape == NULL || sink == NULL) {
+        g_printerr ("missing appsrc, testshape or fakesink element\n");
+        gst_caps_unref (caps);
+        gst_object_unref (pipeline);
+        return -1.0;
+    }
+
+    g_object_set (src, "caps", caps, "format", GST_FORMAT_TIME, "block", TRUE, "max-buffers", (guint64) 4, NULL);
+    g_object_set (sink, "sync", FALSE, NULL);
+
+    if (draw) {
+        gchar *shapes = make_shapes (cfg);
+
+        g_object_set (testshape, "shapes", shapes, "alpha", cfg->alpha, "n_threads", cfg->n_threads, NULL);
+        g_free (shapes);
+    } else {
+        g_object_set (testshape, "shape", "none", NULL);
+    }
+
+    gst_bin_add_many (GST_BIN (pipeline), src, testshape, sink, NULL);
+    gst_element_link_many (src, testshape, sink, NULL);
+
+    /* Buffers are recycled, so the run measures drawing rather than allocation. */
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, GST_VIDEO_INFO_SIZE (&info), 8, 8);
+    gst_buffer_pool_set_config (pool, config);
+    gst_buffer_pool_set_active (pool, TRUE);
+
+    gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < cfg->frames; i++) {
+        GstBuffer *buf;
+
+        if (gst_buffer_pool_acquire_buffer (pool, &buf, NULL) != GST_FLOW_OK)
+            break;
+        GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+        GST_BUFFER_DURATION (buf) = GST_SECOND / 30;
+        if (gst_app_src_push_buffer (GST_APP_SRC (src), buf) != GST_FLOW_OK)
+            break;
+    }
+    gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+    bus = gst_element_get_bus (pipeline);
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    end = g_get_monotonic_time ();
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS && i == cfg->frames)
+        result = (end - start) * 1000.0 / cfg->frames;
+    else
+        g_printerr ("pipeline failed\n");
+
+    gst_message_unref (msg);
+    gst_object_unref (bus);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+    gst_caps_unref (caps);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    gchar *shape = NULL, *resolution = NULL, *format = NULL;
+    gint size = 0, count = 0, frames = 300;
+    gboolean fill = FALSE;
+    gdouble alpha = 1.0;
+    gint n_threads = 1;
+    GOptionEntry entries[] = {
+        { "shape", 0, 0, G_OPTION_ARG_STRING, &shape, "Shape type (square, rectangle, triangle, circle)", "SHAPE" },
+        { "size", 0, 0, G_OPTION_ARG_INT, &size, "Size of the box of every shape in pixels", "N" },
+        { "resolution", 0, 0, G_OPTION_ARG_STRING, &resolution, "Frame size", "WxH" },
+        { "count", 0, 0, G_OPTION_ARG_INT, &count, "Number of shapes per frame", "N" },
+        { "frames", 0, 0, G_OPTION_ARG_INT, &frames, "Number of frames per run (300)", "N" },
+        { "format", 0, 0, G_OPTION_ARG_STRING, &format, "Video format (NV12)", "FORMAT" },
+        { "fill", 0, 0, G_OPTION_ARG_NONE, &fill, "Draw filled shapes", NULL },
+        { "alpha", 0, 0, G_OPTION_ARG_DOUBLE, &alpha, "Opacity of the shapes (1.0)", "A" },
+        { "n-threads", 0, 0, G_OPTION_ARG_INT, &n_threads, "Drawing threads, 0 for all processors (1)", "N" },
+        { NULL }
+    };
+    const gchar **shapes = default_shapes;
+    const gint *sizes = default_sizes, *counts = default_counts;
+    const gint (*resolutions)[2] = default_resolutions;
+    guint n_shapes = G_N_ELEMENTS (default_shapes), n_sizes = G_N_ELEMENTS (default_sizes);
+    guint n_resolutions = G_N_ELEMENTS (default_resolutions), n_counts = G_N_ELEMENTS (default_counts);
+    gint one_resolution[1][2];
+    GOptionContext *ctx;
+    GError *err = NULL;
+    BenchConfig cfg;
+    guint s, z, r, c;
+
+    ctx = g_option_context_new ("- throughput benchmark of the testshape element");
+    g_option_context_add_main_entries (ctx, entries, NULL);
+    g_option_context_add_group (ctx, gst_init_get_option_group ());
+    if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+        g_printerr ("%s\n", err->message);
+        g_clear_error (&err);
+        g_option_context_free (ctx);
+        return 1;
+    }
+    g_option_context_free (ctx);
+
+#ifdef TESTSHAPE_PLUGIN_PATH
+    /* Use the plugin of the build tree rather than an installed one. */
+    {
+        GstPlugin *plugin = gst_plugin_load_file (TESTSHAPE_PLUGIN_PATH, NULL);
+
+        if (plugin != NULL)
+            gst_object_unref (plugin);
+    }
+#endif
+
+    /* An option given on the command line replaces the sweep of its dimension. */
+    if (shape != NULL) {
+        shapes = (const gchar **) &shape;
+        n_shapes = 1;
+    }
+    if (size > 0) {
+        sizes = &size;
+        n_sizes = 1;
+    }
+    if (resolution != NULL) {
+        if (sscanf (resolution, "%dx%d", &one_resolution[0][0], &one_resolution[0][1]) != 2) {
+            g_printerr ("invalid resolution %s\n", resolution);
+            return 1;
+        }
+        resolutions = (const gint (*)[2]) one_resolution;
+        n_resolutions = 1;
+    }
+    if (count > 0) {
+        counts = &count;
+        n_counts = 1;
+    }
+
+    cfg.frames = MAX (frames, 1);
+    cfg.format = format ? format : "NV12";
+    cfg.fill = fill;
+    cfg.alpha = alpha;
+    cfg.n_threads = MAX (n_threads, 0);
+
+    g_print ("%-10s %6s %11s %6s %10s %12s %12s\n", "shape", "size", "resolution", "count", "frames/s", "ns/frame", "draw ns");
+
+    for (r = 0; r < n_resolutions; r++) {
+        gdouble base;
+
+        cfg.width = resolutions[r][0];
+        cfg.height = resolutions[r][1];
+        cfg.shape = shapes[0];
+        cfg.size = sizes[0];
+        cfg.count = counts[0];
+
+        /* Cost of the pipeline without drawing, subtracted from every run. */
+        base = run_bench (&cfg, FALSE);
+        if (base < 0)
+            return 1;
+
+        for (s = 0; s < n_shapes; s++) {
+            for (z = 0; z < n_sizes; z++) {
+                for (c = 0; c < n_counts; c++) {
+                    gchar res[32];
+                    gdouble ns;
+
+                    cfg.shape = shapes[s];
+                    cfg.size = sizes[z];
+                    cfg.count = counts[c];
+
+                    ns = run_bench (&cfg, TRUE);
+                    if (ns < 0)
+                        return 1;
+
+                    g_snprintf (res, sizeof (res), "%dx%d", cfg.width, cfg.height);
+                    g_print ("%-10s %6d %11s %6d %10.1f %12.0f %12.0f\n", cfg.shape, cfg.size, res, cfg.count,
+                        1e9 / ns, ns, MAX (ns - base, 0.0));
+                }
+            }
+        }
+    }
+
+    g_free (shape);
+    g_free (resolution);
+    g_free (format);
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Vinay Kesarwani <<user@hostname.org>>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* testshape-drawbench measures the drawing core without a pipeline.
+ *
+ * For every combination of format, shape type, size, resolution and shape
+ * count it reports the time to rasterize a plan and the time to draw it into
+ * a frame, so rasterizer and plane writer changes can be measured in isolation.
+ *
+ * Usage: testshape-drawbench [--format=NV12] [--shape=circle] [--size=256]
+ *                            [--resolution=1920x1080] [--count=16]
+ *                            [--frames=500] [--fill] [--alpha=1.0]
+ *                            [--antialias] [--vertices=64]
+ * Without one of these options the default sweep is used for that dimension.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include "gsttestshapedraw.h"
+
+static const gchar *default_formats[] = { "NV12", "I420", "YUY2", "P010_10LE", "RGBx" };
+static const gchar *default_shapes[] = { "square", "rectangle", "triangle", "circle", "polygon", "polyline" };
+static const gint default_sizes[] = { 32, 256 };
+static const gint default_resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+static const gint default_counts[] = { 1, 16 };
+
+/* Fills the plan with count shapes spread on a grid, each fitting in a size x size box.
+ * Polygons and polylines are stars of the given number of vertices.
+ */
+static void make_shapes(TestshapePlan *plan, TestshapeShapeType type, gint size, gint width, gint height,
+    gint count, gboolean fill, gdouble alpha, gboolean antialias, gint vertices)
+{
+    gint cols = 1, i, v;
+
+    while (cols * cols < count)
+        cols++;
+
+    g_array_set_size (plan->shapes, 0);
+    g_array_set_size (plan->points, 0);
+    for (i = 0; i < count; i++) {
+        TestshapeShape shape;
+
+        memset (&shape, 0, sizeof (shape));
+        shape.type = type;
+        shape.x = (i % cols) * width / cols + width / (2 * cols);
+        shape.y = (i / cols) * height / cols + height / (2 * cols);
+        shape.width = type == TESTSHAPE_SHAPE_CIRCLE ? size / 2 : size;
+        shape.height = size / 2;
+        shape.thickness = 1;
+        shape.fill = fill;
+        shape.antialias = antialias;
+        if (type == TESTSHAPE_SHAPE_POLYGON || type == TESTSHAPE_SHAPE_POLYLINE) {
+            shape.first_point = plan->points->len;
+            shape.n_points = vertices;
+            for (v = 0; v < vertices; v++) {
+                gdouble angle = 2 * G_PI * v / vertices;
+                gdouble radius = v % 2 ? size / 4.0 : size / 2.0;
+                TestshapePoint point;
+
+                point.x = (gint) (radius * cos (angle));
+                point.y = (gint) (radius * sin (angle));
+                g_array_append_val (plan->points, point);
+            }
+        }
+        gst_testshape_color_parse (i % 2 ? "green" : "red", &shape.color);
+        gst_testshape_color_set_alpha (&shape.color, alpha);
+        g_array_append_val (plan->shapes, shape);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    gchar *format = NULL, *shape = NULL, *resolution = NULL;
+    gint size = 0, count = 0, frames = 500;
+    gboolean fill = FALSE;
+    gdouble alpha = 1.0;
+    gboolean antialias = FALSE;
+    gint vertices = 64;
+    GOptionEntry entries[] = {
+        { "format", 0, 0, G_OPTION_ARG_STRING, &format, "Video format", "FORMAT" },
+        { "shape", 0, 0, G_OPTION_ARG_STRING, &shape, "Shape type (square, rectangle, triangle, circle)", "SHAPE" },
+        { "size", 0, 0, G_OPTION_ARG_INT, &size, "Size of the box of every shape in pixels", "N" },
+        { "resolution", 0, 0, G_OPTION_ARG_STRING, &resolution, "Frame size", "WxH" },
+        { "count", 0, 0, G_OPTION_ARG_INT, &count, "Number of shapes per frame", "N" },
+        { "frames", 0, 0, G_OPTION_ARG_INT, &frames, "Number of frames drawn per run (500)", "N" },
+        { "fill", 0, 0, G_OPTION_ARG_NONE, &fill, "Draw filled shapes", NULL },
+        { "alpha", 0, 0, G_OPTION_ARG_DOUBLE, &alpha, "Opacity of the shapes (1.0)", "A" },
+        { "antialias", 0, 0, G_OPTION_ARG_NONE, &antialias, "Draw anti-aliased shapes", NULL },
+        { "vertices", 0, 0, G_OPTION_ARG_INT, &vertices, "Number of vertices of polygons and polylines (64)", "N" },
+        { NULL }
+    };
+    const gchar **formats = default_formats, **shapes = default_shapes;
+    const gint *sizes = default_sizes, *counts = default_counts;
+    const gint (*resolutions)[2] = default_resolutions;
+    guint n_formats = G_N_ELEMENTS (default_formats), n_shapes = G_N_ELEMENTS (default_shapes);
+    guint n_sizes = G_N_ELEMENTS (default_sizes), n_resolutions = G_N_ELEMENTS (default_resolutions);
+    guint n_counts = G_N_ELEMENTS (default_counts);
+    gint one_resolution[1][2];
+    const TestshapeFillFuncs *funcs;
+    GOptionContext *ctx;
+    GError *err = NULL;
+    TestshapePlan plan;
+    guint f, r, s, z, c;
+
+    ctx = g_option_context_new ("- microbenchmark of the testshape drawing core");
+    g_option_context_add_main_entries (ctx, entries, NULL);
+    if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+        g_printerr ("%s\n", err->message);
+        g_clear_error (&err);
+        g_option_context_free (ctx);
+        return 1;
+    }
+    g_option_context_free (ctx);
+
+    gst_init (&argc, &argv);
+
+    /* An option given on the command line replaces the sweep of its dimension. */
+    if (format != NULL) {
+        formats = (const gchar **) &format;
+        n_formats = 1;
+    }
+    if (shape != NULL) {
+        shapes = (const gchar **) &shape;
+        n_shapes = 1;
+    }
+    if (size > 0) {
+        sizes = &size;
+        n_sizes = 1;
+    }
+    if (resolution != NULL) {
+        if (sscanf (resolution, "%dx%d", &one_resolution[0][0], &one_resolution[0][1]) != 2) {
+            g_printerr ("invalid resolution %s\n", resolution);
+            return 1;
+        }
+        resolutions = (const gint (*)[2]) one_resolution;
+        n_resolutions = 1;
+    }
+    if (count > 0) {
+        counts = &count;
+        n_counts = 1;
+    }
+    frames = MAX (frames, 1);
+    vertices = MAX (vertices, 3);
+
+    funcs = gst_testshape_fill_get_funcs ();
+    g_print ("fill kernels: %s\n", funcs->name);
+    g_print ("%-10s %-10s %6s %11s %6s %12s %12s %10s\n", "format", "shape", "size", "resolution", "count",
+        "raster ns", "ns/frame", "Mpix/s");
+
+    gst_testshape_plan_init (&plan);
+
+    for (f = 0; f < n_formats; f++) {
+        GstVideoFormat fmt = gst_video_format_from_string (formats[f]);
+
+        if (!gst_testshape_plan_set_format (&plan, fmt)) {
+            g_printerr ("unsupported format %s\n", formats[f]);
+            continue;
+        }
+
+        for (r = 0; r < n_resolutions; r++) {
+            GstVideoInfo info;
+            TestshapeImage image;
+            guint8 *data;
+            guint p;
+
+            gst_video_info_set_format (&info, fmt, resolutions[r][0], resolutions[r][1]);
+            data = g_malloc0 (GST_VIDEO_INFO_SIZE (&info));
+            for (p = 0; p < GST_VIDEO_INFO_N_PLANES (&info); p++) {
+                image.data[p] = data + GST_VIDEO_INFO_PLANE_OFFSET (&info, p);
+                image.stride[p] = GST_VIDEO_INFO_PLANE_STRIDE (&info, p);
+            }
+
+            for (s = 0; s < n_shapes; s++) {
+                for (z = 0; z < n_sizes; z++) {
+                    for (c = 0; c < n_counts; c++) {
+                        gint64 start, raster, draw;
+                        gchar res[32];
+                        gint i;
+
+                        make_shapes (&plan, gst_testshape_shape_type_from_string (shapes[s]), sizes[z],
+                            GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info), counts[c], fill, alpha, antialias, vertices);
+
+                        start = g_get_monotonic_time ();
+                        for (i = 0; i < frames; i++)
+                            gst_testshape_plan_rasterize (&plan, GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info));
+                        raster = g_get_monotonic_time () - start;
+
+                        start = g_get_monotonic_time ();
+                        for (i = 0; i < frames; i++)
+                            gst_testshape_plan_draw (&plan, funcs, &image, 0, GST_VIDEO_INFO_HEIGHT (&info));
+                        draw = g_get_monotonic_time () - start;
+
+                        g_snprintf (res, sizeof (res), "%dx%d", GST_VIDEO_INFO_WIDTH (&info), GST_VIDEO_INFO_HEIGHT (&info));
+                        g_print ("%-10s %-10s %6d %11s %6d %12.0f %12.0f %10.1f\n", formats[f], shapes[s], sizes[z], res,
+                            counts[c], raster * 1000.0 / frames, draw * 1000.0 / frames,
+                            draw > 0 ? (gdouble) plan.pixels * frames / draw : 0.0);
+                    }
+                }
+            }
+
+            g_free (data);
+        }
+    }
+
+    gst_testshape_plan_clear (&plan);
+    g_free (format);
+    g_free (shape);
+    g_free (resolution);
+
+    return 0;
+}